@@ -5,6 +5,9 @@
 #include "internal/LowParse.h"
 #include "internal/EverQuic_Krmllib.h"
 #include "internal/EverQuic_EverCrypt.h"
+#include "lib_memzero0.h"
+#include "QUIC_Atomic.h"
+#include "QUIC_Probe.h"
 
 static uint64_t min64(uint64_t x, uint64_t y)
 {
@@ -1969,7 +1972,6 @@ static void
 header_encrypt_ct_secret_preserving_not_retry(
   Spec_Agile_AEAD_alg a,
   NotEverCrypt_CTR_state_s *s,
-  uint8_t *k,
   bool is_short,
   uint32_t pn_offset,
   uint32_t pn_len,
@@ -1989,7 +1991,7 @@ header_encrypt_ct_secret_preserving_not_retry(
       {
         uint32_t ctr = load32_le(sample);
         uint8_t *iv = sample + 4U;
-        NotEverCrypt_CTR_init(s, k, iv, 12U, ctr);
+        NotEverCrypt_CTR_reset(s, iv, 12U, ctr);
         NotEverCrypt_CTR_update_block(s, dst_block, zeroes);
         uint8_t *dst_slice = dst_block;
         memcpy(mask, dst_slice, 16U * sizeof (uint8_t));
@@ -1999,7 +2001,7 @@ header_encrypt_ct_secret_preserving_not_retry(
       {
         uint32_t ctr = load32_be(sample + 12U);
         uint8_t *iv = sample;
-        NotEverCrypt_CTR_init(s, k, iv, 12U, ctr);
+        NotEverCrypt_CTR_reset(s, iv, 12U, ctr);
         NotEverCrypt_CTR_update_block(s, dst_block, zeroes);
         uint8_t *dst_slice = dst_block;
         memcpy(mask, dst_slice, 16U * sizeof (uint8_t));
@@ -2046,7 +2048,6 @@ static void
 header_encrypt(
   Spec_Agile_AEAD_alg a,
   NotEverCrypt_CTR_state_s *s,
-  uint8_t *k,
   uint8_t *dst,
   bool is_short,
   bool is_retry,
@@ -2056,8 +2057,10 @@ header_encrypt(
 {
   if (!is_retry)
   {
+    uint64_t t0 = QUIC_Probe_start();
     uint8_t *bs = dst;
-    header_encrypt_ct_secret_preserving_not_retry(a, s, k, is_short, public_len, pn_len, bs);
+    header_encrypt_ct_secret_preserving_not_retry(a, s, is_short, public_len, pn_len, bs);
+    QUIC_Probe_stop(1U, t0);
   }
 }
 
@@ -2079,7 +2082,6 @@ static void
 header_decrypt_aux_ct_secret_preserving_not_retry(
   Spec_Agile_AEAD_alg a,
   NotEverCrypt_CTR_state_s *s,
-  uint8_t *k,
   bool is_short,
   uint32_t pn_offset,
   uint8_t *dst
@@ -2101,7 +2103,7 @@ header_decrypt_aux_ct_secret_preserving_not_retry(
       {
         uint32_t ctr = load32_le(sample);
         uint8_t *iv = sample + 4U;
-        NotEverCrypt_CTR_init(s, k, iv, 12U, ctr);
+        NotEverCrypt_CTR_reset(s, iv, 12U, ctr);
         NotEverCrypt_CTR_update_block(s, dst_block, zeroes);
         uint8_t *dst_slice = dst_block;
         memcpy(mask, dst_slice, 16U * sizeof (uint8_t));
@@ -2111,7 +2113,7 @@ header_decrypt_aux_ct_secret_preserving_not_retry(
       {
         uint32_t ctr = load32_be(sample + 12U);
         uint8_t *iv = sample;
-        NotEverCrypt_CTR_init(s, k, iv, 12U, ctr);
+        NotEverCrypt_CTR_reset(s, iv, 12U, ctr);
         NotEverCrypt_CTR_update_block(s, dst_block, zeroes);
         uint8_t *dst_slice = dst_block;
         memcpy(mask, dst_slice, 16U * sizeof (uint8_t));
@@ -2165,7 +2167,6 @@ static header_decrypt_aux_result
 header_decrypt_aux(
   Spec_Agile_AEAD_alg a,
   NotEverCrypt_CTR_state_s *s,
-  uint8_t *k,
   uint32_t cid_len,
   uint8_t *dst,
   uint32_t dst_len
@@ -2194,7 +2195,9 @@ header_decrypt_aux(
           return HD_Failure;
         else
         {
-          header_decrypt_aux_ct_secret_preserving_not_retry(a, s, k, isshort, pn_offset, dst);
+          uint64_t t0 = QUIC_Probe_start();
+          header_decrypt_aux_ct_secret_preserving_not_retry(a, s, isshort, pn_offset, dst);
+          QUIC_Probe_stop(1U, t0);
           return HD_Success_NotRetry;
         }
       }
@@ -2224,14 +2227,13 @@ static h_result
 header_decrypt(
   Spec_Agile_AEAD_alg a,
   NotEverCrypt_CTR_state_s *s,
-  uint8_t *k,
   uint32_t cid_len,
   uint64_t last,
   uint8_t *dst,
   uint32_t dst_len
 )
 {
-  header_decrypt_aux_result aux = header_decrypt_aux(a, s, k, cid_len, dst, dst_len);
+  header_decrypt_aux_result aux = header_decrypt_aux(a, s, cid_len, dst, dst_len);
   switch (aux)
   {
     case HD_Failure:
@@ -2244,18 +2246,22 @@ header_decrypt(
           return ((h_result){ .tag = H_Failure });
         else
         {
+          uint64_t t0 = QUIC_Probe_start();
           __QUIC_Impl_Header_Base_header_uint64_t scrut = read_header0(dst, dst_len, cid_len, last);
           EverQuic_header h = scrut.fst;
           uint64_t pn = scrut.snd;
+          QUIC_Probe_stop(0U, t0);
           return ((h_result){ .tag = H_Success, .h = h, .pn = pn, .cipher_length = 0U });
         }
         break;
       }
     default:
       {
+        uint64_t t0 = QUIC_Probe_start();
         __QUIC_Impl_Header_Base_header_uint64_t scrut = read_header0(dst, dst_len, cid_len, last);
         EverQuic_header h = scrut.fst;
         uint64_t pn = scrut.snd;
+        QUIC_Probe_stop(0U, t0);
         uint32_t hlen = EverQuic_header_len(h);
         uint32_t rlen = dst_len - hlen;
         uint64_t rlen64 = (uint64_t)rlen;
@@ -2272,12 +2278,68 @@ header_decrypt(
   }
 }
 
+static uint64_t bit_mask(uint64_t b)
+{
+  uint64_t c = FStar_UInt64_eq_mask(b >> 0U & 1ULL, 1ULL);
+  uint64_t m = (1ULL << 1U & c) | (1ULL & ~c);
+  uint64_t c0 = FStar_UInt64_eq_mask(b >> 1U & 1ULL, 1ULL);
+  uint64_t m0 = (m << 2U & c0) | (m & ~c0);
+  uint64_t c1 = FStar_UInt64_eq_mask(b >> 2U & 1ULL, 1ULL);
+  uint64_t m1 = (m0 << 4U & c1) | (m0 & ~c1);
+  uint64_t c2 = FStar_UInt64_eq_mask(b >> 3U & 1ULL, 1ULL);
+  uint64_t m2 = (m1 << 8U & c2) | (m1 & ~c2);
+  uint64_t c3 = FStar_UInt64_eq_mask(b >> 4U & 1ULL, 1ULL);
+  uint64_t m3 = (m2 << 16U & c3) | (m2 & ~c3);
+  uint64_t c4 = FStar_UInt64_eq_mask(b >> 5U & 1ULL, 1ULL);
+  uint64_t m4 = (m3 << 32U & c4) | (m3 & ~c4);
+  return m4;
+}
+
+static bool replay_check(uint64_t *w, uint32_t n, uint64_t last, uint64_t pn)
+{
+  uint64_t acc = 0ULL;
+  uint64_t wi = pn >> 6U & (uint64_t)(n - 1U);
+  uint64_t bit = bit_mask(pn & 63ULL);
+  for (uint32_t i = 0U; i < n; i++)
+  {
+    uint64_t sel = FStar_UInt64_eq_mask((uint64_t)i, wi);
+    acc = acc | (w[i] & bit & sel);
+  }
+  uint64_t seen = ~FStar_UInt64_eq_mask(acc, 0ULL);
+  uint64_t span = (uint64_t)(64U * (n - 1U));
+  uint64_t
+  fresh = ~FStar_UInt64_gte_mask(last, pn) | (~FStar_UInt64_gte_mask(last - pn, span) & ~seen);
+  return fresh != 0ULL;
+}
+
+static void replay_update(uint64_t *w, uint32_t n, uint64_t last, uint64_t pn)
+{
+  uint64_t mask = (uint64_t)(n - 1U);
+  uint64_t lw = last >> 6U;
+  uint64_t pw = pn >> 6U;
+  uint64_t d = pw - lw;
+  uint64_t ahead = ~FStar_UInt64_gte_mask(last, pn);
+  uint64_t all = FStar_UInt64_gte_mask(d, (uint64_t)n);
+  uint64_t wi = pw & mask;
+  uint64_t bit = bit_mask(pn & 63ULL);
+  for (uint32_t i = 0U; i < n; i++)
+  {
+    uint64_t j64 = (uint64_t)i;
+    uint64_t dj = (j64 - lw - 1ULL) & mask;
+    uint64_t recycle = ahead & (all | ~FStar_UInt64_gte_mask(dj, d));
+    uint64_t sel = FStar_UInt64_eq_mask(j64, wi);
+    w[i] = (w[i] & ~recycle) | (bit & sel);
+  }
+}
+
 static uint8_t label_key[3U] = { 0x6bU, 0x65U, 0x79U };
 
 static uint8_t label_iv[2U] = { 0x69U, 0x76U };
 
 static uint8_t label_hp[2U] = { 0x68U, 0x70U };
 
+static uint8_t label_ku[2U] = { 0x6bU, 0x75U };
+
 static uint8_t
 prefix[11U] = { 0x74U, 0x6cU, 0x73U, 0x31U, 0x33U, 0x20U, 0x71U, 0x75U, 0x69U, 0x63U, 0x20U };
 
@@ -2407,9 +2469,13 @@ payload_encrypt(
   uint8_t *aad = dst;
   uint8_t *cipher = dst + header_len;
   uint8_t *tag = dst + header_len + plain_len;
+  uint64_t t0 = QUIC_Probe_start();
   iv_for_encrypt_decrypt(siv, iv, pn);
+  QUIC_Probe_stop(2U, t0);
+  uint64_t t1 = QUIC_Probe_start();
   EverCrypt_Error_error_code
   res = EverCrypt_AEAD_encrypt(s, iv, 12U, aad, header_len, plain, plain_len, cipher, tag);
+  QUIC_Probe_stop(3U, t1);
   return res;
 }
 
@@ -2419,7 +2485,6 @@ encrypt(
   EverCrypt_AEAD_state_s *aead,
   uint8_t *siv,
   NotEverCrypt_CTR_state_s *ctr,
-  uint8_t *hpk,
   uint8_t *dst,
   EverQuic_header h,
   uint64_t pn,
@@ -2438,7 +2503,7 @@ encrypt(
   if (isretry)
   {
     uint32_t dummy_pn_len = 1U;
-    header_encrypt(a, ctr, hpk, dst, false, true, EverQuic_public_header_len(h), dummy_pn_len);
+    header_encrypt(a, ctr, dst, false, true, EverQuic_public_header_len(h), dummy_pn_len);
     return EverCrypt_Error_Success;
   }
   else
@@ -2454,7 +2519,6 @@ encrypt(
         {
           header_encrypt(a,
             ctr,
-            hpk,
             dst,
             EverQuic_uu___is_BShort(h),
             isretry,
@@ -2470,6 +2534,85 @@ encrypt(
   }
 }
 
+static EverCrypt_Error_error_code
+payload_encrypt_in_place(
+  EverCrypt_AEAD_state_s *s,
+  uint8_t *siv,
+  uint8_t *dst,
+  uint64_t pn,
+  uint32_t header_len,
+  uint32_t plain_len
+)
+{
+  uint8_t iv[12U] = { 0U };
+  uint8_t *aad = dst;
+  uint8_t *cipher = dst + header_len;
+  uint8_t *tag = dst + header_len + plain_len;
+  uint64_t t0 = QUIC_Probe_start();
+  iv_for_encrypt_decrypt(siv, iv, pn);
+  QUIC_Probe_stop(2U, t0);
+  uint64_t t1 = QUIC_Probe_start();
+  EverCrypt_Error_error_code
+  res = EverCrypt_AEAD_encrypt(s, iv, 12U, aad, header_len, cipher, plain_len, cipher, tag);
+  QUIC_Probe_stop(3U, t1);
+  return res;
+}
+
+static void
+gather(EverQuic_iovec *iov, uint32_t iov_count, uint8_t *dst, uint32_t header_len)
+{
+  uint32_t hl = header_len;
+  uint32_t off = hl;
+  for (uint32_t i = 0U; i < iov_count; i++)
+  {
+    EverQuic_iovec v = iov[i];
+    memcpy(dst + off, v.iov_base, v.iov_len * sizeof (uint8_t));
+    off = off + v.iov_len;
+  }
+}
+
+static EverCrypt_Error_error_code
+encrypt_gather(
+  Spec_Agile_AEAD_alg a,
+  EverCrypt_AEAD_state_s *aead,
+  uint8_t *siv,
+  NotEverCrypt_CTR_state_s *ctr,
+  uint8_t *dst,
+  EverQuic_header h,
+  uint64_t pn,
+  EverQuic_iovec *iov,
+  uint32_t iov_count,
+  uint32_t plain_len
+)
+{
+  uint32_t header_len = EverQuic_header_len(h);
+  write_header0(h, pn, dst, header_len + plain_len + 16U);
+  uint32_t pn_len = EverQuic_pn_length(h);
+  uint8_t *bs = dst;
+  gather(iov, iov_count, bs, header_len);
+  EverCrypt_Error_error_code
+  res = payload_encrypt_in_place(aead, siv, bs, pn, header_len, plain_len);
+  EverCrypt_Error_error_code res0 = res;
+  switch (res0)
+  {
+    case EverCrypt_Error_Success:
+      {
+        header_encrypt(a,
+          ctr,
+          dst,
+          EverQuic_uu___is_BShort(h),
+          false,
+          EverQuic_public_header_len(h),
+          pn_len);
+        return res0;
+      }
+    default:
+      {
+        return res0;
+      }
+  }
+}
+
 static EverCrypt_Error_error_code
 payload_decrypt(
   EverCrypt_AEAD_state_s *s,
@@ -2485,29 +2628,74 @@ payload_decrypt(
   uint8_t *aad = dst;
   uint8_t *cipher = dst + hlen;
   uint8_t *tag = dst + hlen + cipher_len;
+  uint64_t t0 = QUIC_Probe_start();
   iv_for_encrypt_decrypt(siv, iv, pn);
+  QUIC_Probe_stop(2U, t0);
+  uint64_t t1 = QUIC_Probe_start();
   EverCrypt_Error_error_code
   res = EverCrypt_AEAD_decrypt(s, iv, 12U, aad, hlen, cipher, cipher_len, tag, cipher);
+  QUIC_Probe_stop(3U, t1);
   return res;
 }
 
-static EverCrypt_Error_error_code
+#define PreviousKeys 0
+#define CurrentKeys 1
+#define NextKeys 2
+
+typedef uint8_t key_choice;
+
+static key_choice
+select_keys(
+  bool has_prev,
+  bool has_next,
+  uint8_t phase,
+  uint64_t phase_pn,
+  EverQuic_header h,
+  uint64_t pn
+)
+{
+  if (h.tag == EverQuic_BShort && h.case_BShort.phase != phase)
+  {
+    bool above;
+    if (phase_pn == 0x3fffffffffffffffULL)
+      above = !has_prev;
+    else
+      above = phase_pn < pn;
+    if (has_next && above)
+      return NextKeys;
+    else if (has_prev)
+      return PreviousKeys;
+    else
+      return CurrentKeys;
+  }
+  else
+    return CurrentKeys;
+}
+
+static EverQuic_status
 decrypt(
   Spec_Agile_AEAD_alg a,
   EverCrypt_AEAD_state_s *aead,
   uint8_t *siv,
+  EverCrypt_AEAD_state_s *prev_aead,
+  uint8_t *prev_siv,
+  EverCrypt_AEAD_state_s *next_aead,
+  uint8_t *next_siv,
+  uint8_t phase,
+  uint64_t phase_pn,
   NotEverCrypt_CTR_state_s *ctr,
-  uint8_t *hpk,
   uint8_t *dst,
   uint32_t dst_len,
   EverQuic_result *dst_hdr,
   uint64_t last_pn,
+  uint64_t *window,
+  uint32_t window_len,
   uint32_t cid_len
 )
 {
-  h_result scrut = header_decrypt(a, ctr, hpk, cid_len, last_pn, dst, dst_len);
+  h_result scrut = header_decrypt(a, ctr, cid_len, last_pn, dst, dst_len);
   if (scrut.tag == H_Failure)
-    return EverCrypt_Error_DecodeError;
+    return EverQuic_Malformed;
   else if (scrut.tag == H_Success)
   {
     uint32_t cipher_and_tag_len = scrut.cipher_length;
@@ -2519,15 +2707,43 @@ decrypt(
       EverQuic_result
       r = { .pn = pn, .header = h, .header_len = hlen, .plain_len = 0U, .total_len = hlen };
       dst_hdr[0U] = r;
-      return EverCrypt_Error_Success;
+      return EverQuic_Ok;
     }
     else
     {
+      bool replayed = window_len != 0U && !replay_check(window, window_len, last_pn, pn);
+      key_choice
+      keys = select_keys(!(prev_aead == NULL), !(next_aead == NULL), phase, phase_pn, h, pn);
+      EverCrypt_AEAD_state_s *aead1;
+      if (keys == PreviousKeys)
+        aead1 = prev_aead;
+      else if (keys == NextKeys)
+        aead1 = next_aead;
+      else
+        aead1 = aead;
+      uint8_t *siv1;
+      if (keys == PreviousKeys)
+        siv1 = prev_siv;
+      else if (keys == NextKeys)
+        siv1 = next_siv;
+      else
+        siv1 = siv;
       EverQuic_pn_length(h);
       uint32_t plain_len = cipher_and_tag_len - 16U;
-      uint8_t *bs = dst;
-      EverCrypt_Error_error_code res = payload_decrypt(aead, siv, bs, hlen, pn, cipher_and_tag_len);
-      EverCrypt_Error_error_code res0 = res;
+      EverQuic_status res;
+      if (replayed)
+        res = EverQuic_Replayed;
+      else
+      {
+        uint8_t *bs = dst;
+        EverCrypt_Error_error_code
+        res0 = payload_decrypt(aead1, siv1, bs, hlen, pn, cipher_and_tag_len);
+        EverCrypt_Error_error_code res1 = res0;
+        if (res1 == EverCrypt_Error_Success)
+          res = EverQuic_Ok;
+        else
+          res = EverQuic_Unauthenticated;
+      }
       EverQuic_result
       r =
         {
@@ -2535,7 +2751,7 @@ decrypt(
           .total_len = hlen + cipher_and_tag_len
         };
       dst_hdr[0U] = r;
-      return res0;
+      return res;
     }
   }
   else
@@ -2577,6 +2793,44 @@ static uint32_t key_len32(Spec_Agile_AEAD_alg a)
   return (uint32_t)key_len(a);
 }
 
+static uint8_t hash_len(Spec_Hash_Definitions_hash_alg a)
+{
+  switch (a)
+  {
+    case Spec_Hash_Definitions_SHA1:
+      {
+        return 20U;
+      }
+    case Spec_Hash_Definitions_SHA2_256:
+      {
+        return 32U;
+      }
+    case Spec_Hash_Definitions_SHA2_384:
+      {
+        return 48U;
+      }
+    case Spec_Hash_Definitions_SHA2_512:
+      {
+        return 64U;
+      }
+    default:
+      {
+        KRML_HOST_EPRINTF("KaRaMeL incomplete match at %s:%d\n", __FILE__, __LINE__);
+        KRML_HOST_EXIT(253U);
+      }
+  }
+}
+
+static uint32_t hash_len32(Spec_Hash_Definitions_hash_alg a)
+{
+  return (uint32_t)hash_len(a);
+}
+
+static uint32_t keys_len(Spec_Hash_Definitions_hash_alg h, Spec_Agile_AEAD_alg a)
+{
+  return 36U + key_len32(a) + hash_len32(h);
+}
+
 typedef struct EverQuic_state_s_s
 {
   Spec_Hash_Definitions_hash_alg the_hash_alg;
@@ -2586,6 +2840,16 @@ typedef struct EverQuic_state_s_s
   uint8_t *hp_key;
   uint64_t *pn;
   NotEverCrypt_CTR_state_s *ctr_state;
+  uint8_t *keys;
+  uint8_t *secret;
+  EverCrypt_AEAD_state_s *prev_aead_state;
+  uint8_t *prev_iv;
+  EverCrypt_AEAD_state_s *next_aead_state;
+  uint8_t *next_iv;
+  uint8_t phase;
+  uint64_t *phase_pn;
+  uint64_t *window;
+  uint32_t window_len;
 }
 EverQuic_state_s;
 
@@ -2609,7 +2873,7 @@ Spec_Hash_Definitions_hash_alg EverQuic_hash_alg_of_state(EverQuic_state_s *s)
 uint64_t EverQuic_last_packet_number_of_state(EverQuic_state_s *s)
 {
   uint64_t *pn = (*s).pn;
-  return *pn;
+  return pn[0U];
 }
 
 static void
@@ -2618,87 +2882,235 @@ create_in_core(
   EverQuic_state_s **dst,
   uint64_t initial_pn,
   uint8_t *traffic_secret,
+  uint8_t *hp_key_,
   EverCrypt_AEAD_state_s *aead_state,
-  NotEverCrypt_CTR_state_s *ctr_state
+  NotEverCrypt_CTR_state_s *ctr_state,
+  uint32_t window_len
 )
 {
-  uint8_t *iv = KRML_HOST_CALLOC(12U, sizeof (uint8_t));
-  KRML_CHECK_SIZE(sizeof (uint8_t), key_len32(i.aead_alg));
-  uint8_t *hp_key = KRML_HOST_CALLOC(key_len32(i.aead_alg), sizeof (uint8_t));
-  uint64_t *pn = KRML_HOST_MALLOC(sizeof (uint64_t));
-  pn[0U] = initial_pn;
+  KRML_CHECK_SIZE(sizeof (uint8_t), keys_len(i.hash_alg, i.aead_alg));
+  uint8_t *keys = KRML_HOST_CALLOC(keys_len(i.hash_alg, i.aead_alg), sizeof (uint8_t));
+  uint8_t *iv = keys;
+  uint8_t *hp_key = keys + 12U;
+  uint8_t *prev_iv = keys + 12U + key_len32(i.aead_alg);
+  uint8_t *next_iv = keys + 24U + key_len32(i.aead_alg);
+  uint8_t *secret = keys + 36U + key_len32(i.aead_alg);
+  uint64_t *pn = KRML_HOST_MALLOC(sizeof (uint64_t) * 2U);
+  for (uint32_t _i = 0U; _i < 2U; ++_i)
+    pn[_i] = initial_pn;
+  uint64_t *phase_pn = pn + 1U;
+  *phase_pn = 0x3fffffffffffffffULL;
+  uint64_t *window;
+  if (window_len == 0U)
+    window = NULL;
+  else
+  {
+    KRML_CHECK_SIZE(sizeof (uint64_t), window_len);
+    uint64_t *buf = KRML_HOST_CALLOC(window_len, sizeof (uint64_t));
+    window = buf;
+  }
   EverQuic_state_s
   s =
     {
       .the_hash_alg = i.hash_alg, .the_aead_alg = i.aead_alg, .aead_state = aead_state, .iv = iv,
-      .hp_key = hp_key, .pn = pn, .ctr_state = ctr_state
+      .hp_key = hp_key, .pn = pn, .ctr_state = ctr_state, .keys = keys, .secret = secret,
+      .prev_aead_state = NULL, .prev_iv = prev_iv, .next_aead_state = NULL, .next_iv = next_iv,
+      .phase = 0U, .phase_pn = phase_pn, .window = window, .window_len = window_len
     };
   EverQuic_state_s *s1 = KRML_HOST_MALLOC(sizeof (EverQuic_state_s));
   s1[0U] = s;
   derive_secret(i.hash_alg, iv, 12U, traffic_secret, label_iv, 2U);
-  derive_secret(i.hash_alg, hp_key, key_len(i.aead_alg), traffic_secret, label_hp, 2U);
+  memcpy(hp_key, hp_key_, key_len32(i.aead_alg) * sizeof (uint8_t));
+  memcpy(secret, traffic_secret, hash_len32(i.hash_alg) * sizeof (uint8_t));
   *dst = s1;
 }
 
-EverCrypt_Error_error_code
-EverQuic_create_in(
+static void create_next_keys(EverQuic_state_s *s)
+{
+  EverQuic_state_s scrut = *s;
+  Spec_Hash_Definitions_hash_alg hash_alg = scrut.the_hash_alg;
+  Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
+  EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
+  uint8_t *iv = scrut.iv;
+  uint8_t *hp_key = scrut.hp_key;
+  uint64_t *pn = scrut.pn;
+  NotEverCrypt_CTR_state_s *ctr_state = scrut.ctr_state;
+  uint8_t *keys = scrut.keys;
+  uint8_t *secret = scrut.secret;
+  EverCrypt_AEAD_state_s *prev_aead_state = scrut.prev_aead_state;
+  uint8_t *prev_iv = scrut.prev_iv;
+  uint8_t *next_iv = scrut.next_iv;
+  uint8_t phase = scrut.phase;
+  uint64_t *phase_pn = scrut.phase_pn;
+  uint64_t *window = scrut.window;
+  uint32_t window_len = scrut.window_len;
+  KRML_CHECK_SIZE(sizeof (uint8_t), hash_len32(hash_alg));
+  uint8_t next_secret[hash_len32(hash_alg)];
+  memset(next_secret, 0U, hash_len32(hash_alg) * sizeof (uint8_t));
+  KRML_CHECK_SIZE(sizeof (uint8_t), key_len32(aead_alg));
+  uint8_t aead_key[key_len32(aead_alg)];
+  memset(aead_key, 0U, key_len32(aead_alg) * sizeof (uint8_t));
+  EverCrypt_AEAD_state_s *next_aead_state = NULL;
+  derive_secret(hash_alg, next_secret, hash_len(hash_alg), secret, label_ku, 2U);
+  derive_secret(hash_alg, aead_key, key_len(aead_alg), next_secret, label_key, 3U);
+  EverCrypt_Error_error_code ret = EverCrypt_AEAD_create_in(aead_alg, &next_aead_state, aead_key);
+  Lib_Memzero0_memzero(aead_key, key_len32(aead_alg), uint8_t, void *);
+  if (ret == EverCrypt_Error_Success)
+  {
+    derive_secret(hash_alg, next_iv, 12U, next_secret, label_iv, 2U);
+    s[0U]
+    =
+      (
+        (EverQuic_state_s){
+          .the_hash_alg = hash_alg,
+          .the_aead_alg = aead_alg,
+          .aead_state = aead_state,
+          .iv = iv,
+          .hp_key = hp_key,
+          .pn = pn,
+          .ctr_state = ctr_state,
+          .keys = keys,
+          .secret = secret,
+          .prev_aead_state = prev_aead_state,
+          .prev_iv = prev_iv,
+          .next_aead_state = next_aead_state,
+          .next_iv = next_iv,
+          .phase = phase,
+          .phase_pn = phase_pn,
+          .window = window,
+          .window_len = window_len
+        }
+      );
+  }
+  Lib_Memzero0_memzero(next_secret, hash_len32(hash_alg), uint8_t, void *);
+}
+
+static EverCrypt_Error_error_code
+create_in_window(
   EverQuic_index i,
   EverQuic_state_s **dst,
   uint64_t initial_pn,
-  uint8_t *traffic_secret
+  uint8_t *traffic_secret,
+  uint32_t window_len
 )
 {
   KRML_CHECK_SIZE(sizeof (uint8_t), key_len32(i.aead_alg));
   uint8_t aead_key[key_len32(i.aead_alg)];
   memset(aead_key, 0U, key_len32(i.aead_alg) * sizeof (uint8_t));
+  KRML_CHECK_SIZE(sizeof (uint8_t), key_len32(i.aead_alg));
+  uint8_t hp_key[key_len32(i.aead_alg)];
+  memset(hp_key, 0U, key_len32(i.aead_alg) * sizeof (uint8_t));
   EverCrypt_AEAD_state_s *aead_state = NULL;
   NotEverCrypt_CTR_state_s *ctr_state = NULL;
   uint8_t dummy_iv[12U] = { 0U };
   derive_secret(i.hash_alg, aead_key, key_len(i.aead_alg), traffic_secret, label_key, 3U);
+  derive_secret(i.hash_alg, hp_key, key_len(i.aead_alg), traffic_secret, label_hp, 2U);
   EverCrypt_Error_error_code ret = EverCrypt_AEAD_create_in(i.aead_alg, &aead_state, aead_key);
+  Lib_Memzero0_memzero(aead_key, key_len32(i.aead_alg), uint8_t, void *);
   EverCrypt_Error_error_code
   ret_ =
     NotEverCrypt_CTR_create_in(Spec_Agile_AEAD_cipher_alg_of_supported_alg(i.aead_alg),
       &ctr_state,
-      aead_key,
+      hp_key,
       dummy_iv,
       12U,
       0U);
-  switch (ret)
+  EverCrypt_Error_error_code ret0;
+  if (ret == EverCrypt_Error_Success && ret_ == EverCrypt_Error_Success)
   {
-    case EverCrypt_Error_UnsupportedAlgorithm:
-      {
-        return EverCrypt_Error_UnsupportedAlgorithm;
-      }
-    case EverCrypt_Error_Success:
-      {
-        switch (ret_)
-        {
-          case EverCrypt_Error_UnsupportedAlgorithm:
-            {
-              return EverCrypt_Error_UnsupportedAlgorithm;
-            }
-          case EverCrypt_Error_Success:
-            {
-              EverCrypt_AEAD_state_s *aead_state1 = aead_state;
-              NotEverCrypt_CTR_state_s *ctr_state1 = ctr_state;
-              create_in_core(i, dst, initial_pn, traffic_secret, aead_state1, ctr_state1);
-              return EverCrypt_Error_Success;
-            }
-          default:
-            {
-              KRML_HOST_EPRINTF("KaRaMeL incomplete match at %s:%d\n", __FILE__, __LINE__);
-              KRML_HOST_EXIT(253U);
-            }
-        }
-        break;
-      }
-    default:
-      {
-        KRML_HOST_EPRINTF("KaRaMeL incomplete match at %s:%d\n", __FILE__, __LINE__);
-        KRML_HOST_EXIT(253U);
-      }
+    EverCrypt_AEAD_state_s *aead_state1 = aead_state;
+    NotEverCrypt_CTR_state_s *ctr_state1 = ctr_state;
+    create_in_core(i,
+      dst,
+      initial_pn,
+      traffic_secret,
+      hp_key,
+      aead_state1,
+      ctr_state1,
+      window_len);
+    ret0 = EverCrypt_Error_Success;
+  }
+  else
+  {
+    if (ret == EverCrypt_Error_Success)
+      EverCrypt_AEAD_free(aead_state);
+    if (ret_ == EverCrypt_Error_Success)
+      NotEverCrypt_CTR_free(ctr_state);
+    ret0 = EverCrypt_Error_UnsupportedAlgorithm;
+  }
+  Lib_Memzero0_memzero(hp_key, key_len32(i.aead_alg), uint8_t, void *);
+  return ret0;
+}
+
+EverCrypt_Error_error_code
+EverQuic_create_in(
+  EverQuic_index i,
+  EverQuic_state_s **dst,
+  uint64_t initial_pn,
+  uint8_t *traffic_secret
+)
+{
+  return create_in_window(i, dst, initial_pn, traffic_secret, 0U);
+}
+
+bool EverQuic_valid_window_bits(uint32_t window_bits)
+{
+  return
+    window_bits
+    == 128U
+    || window_bits == 256U
+    || window_bits == 512U
+    || window_bits == 1024U
+    || window_bits == 2048U
+    || window_bits == 4096U;
+}
+
+EverQuic_status
+EverQuic_create_in_with_replay_window(
+  EverQuic_index i,
+  EverQuic_state_s **dst,
+  uint64_t initial_pn,
+  uint8_t *traffic_secret,
+  uint32_t window_bits
+)
+{
+  if (EverQuic_valid_window_bits(window_bits))
+  {
+    EverCrypt_Error_error_code
+    scrut = create_in_window(i, dst, initial_pn, traffic_secret, window_bits / 64U);
+    if (scrut == EverCrypt_Error_Success)
+      return EverQuic_Ok;
+    else
+      return EverQuic_Unsupported;
   }
+  else
+    return EverQuic_InvalidWindowSize;
+}
+
+void EverQuic_free(EverQuic_state_s *s)
+{
+  EverQuic_state_s scrut = *s;
+  Spec_Hash_Definitions_hash_alg hash_alg = scrut.the_hash_alg;
+  Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
+  EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
+  uint64_t *pn = scrut.pn;
+  NotEverCrypt_CTR_state_s *ctr_state = scrut.ctr_state;
+  uint8_t *keys = scrut.keys;
+  EverCrypt_AEAD_state_s *prev_aead_state = scrut.prev_aead_state;
+  EverCrypt_AEAD_state_s *next_aead_state = scrut.next_aead_state;
+  uint64_t *window = scrut.window;
+  Lib_Memzero0_memzero(keys, keys_len(hash_alg, aead_alg), uint8_t, void *);
+  EverCrypt_AEAD_free(aead_state);
+  if (!(prev_aead_state == NULL))
+    EverCrypt_AEAD_free(prev_aead_state);
+  if (!(next_aead_state == NULL))
+    EverCrypt_AEAD_free(next_aead_state);
+  NotEverCrypt_CTR_free(ctr_state);
+  KRML_HOST_FREE(keys);
+  KRML_HOST_FREE(pn);
+  if (!(window == NULL))
+    KRML_HOST_FREE(window);
+  KRML_HOST_FREE(s);
 }
 
 EverCrypt_Error_error_code
@@ -2715,14 +3127,57 @@ EverQuic_encrypt(
   Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
   EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
   uint8_t *iv = scrut.iv;
-  uint8_t *hp_key = scrut.hp_key;
   uint64_t *bpn = scrut.pn;
   NotEverCrypt_CTR_state_s *ctr_state = scrut.ctr_state;
-  uint64_t last_pn = *bpn;
+  uint64_t last_pn = bpn[0U];
+  uint64_t pn = last_pn + 1ULL;
+  bpn[0U] = pn;
+  dst_pn[0U] = pn;
+  return encrypt(aead_alg, aead_state, iv, ctr_state, dst, h, pn, plain, plain_len);
+}
+
+static uint32_t iovecs_length(EverQuic_iovec *plain, uint32_t plain_count)
+{
+  uint32_t acc = 0U;
+  for (uint32_t i = 0U; i < plain_count; i++)
+  {
+    acc = acc + plain[i].iov_len;
+  }
+  return acc;
+}
+
+EverCrypt_Error_error_code
+EverQuic_encrypt_gather(
+  EverQuic_state_s *s,
+  uint8_t *dst,
+  uint64_t *dst_pn,
+  EverQuic_header h,
+  EverQuic_iovec *plain,
+  uint32_t plain_count
+)
+{
+  uint32_t plain_len = iovecs_length(plain, plain_count);
+  EverQuic_state_s scrut = *s;
+  Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
+  EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
+  uint8_t *iv = scrut.iv;
+  uint64_t *bpn = scrut.pn;
+  NotEverCrypt_CTR_state_s *ctr_state = scrut.ctr_state;
+  uint64_t last_pn = bpn[0U];
   uint64_t pn = last_pn + 1ULL;
   bpn[0U] = pn;
   dst_pn[0U] = pn;
-  return encrypt(aead_alg, aead_state, iv, ctr_state, hp_key, dst, h, pn, plain, plain_len);
+  return
+    encrypt_gather(aead_alg,
+      aead_state,
+      iv,
+      ctr_state,
+      dst,
+      h,
+      pn,
+      plain,
+      plain_count,
+      plain_len);
 }
 
 static uint8_t
@@ -2761,9 +3216,10 @@ EverQuic_initial_secrets(
   EverCrypt_HKDF_expand(Spec_Hash_Definitions_SHA2_256, dst_server, secret, 32U, bs1, 9U, 32U);
 }
 
-EverCrypt_Error_error_code
-EverQuic_decrypt(
+static EverQuic_status
+decrypt_core(
   EverQuic_state_s *s,
+  bool next_keys,
   EverQuic_result *dst,
   uint8_t *packet,
   uint32_t len,
@@ -2774,32 +3230,901 @@ EverQuic_decrypt(
   Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
   EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
   uint8_t *iv = scrut.iv;
-  uint8_t *hp_key = scrut.hp_key;
   uint64_t *bpn = scrut.pn;
   NotEverCrypt_CTR_state_s *ctr_state = scrut.ctr_state;
-  uint64_t last_pn = *bpn;
-  EverCrypt_Error_error_code
+  EverCrypt_AEAD_state_s *prev_aead_state = scrut.prev_aead_state;
+  uint8_t *prev_iv = scrut.prev_iv;
+  EverCrypt_AEAD_state_s *next_aead_state = scrut.next_aead_state;
+  uint8_t *next_iv = scrut.next_iv;
+  uint8_t phase = scrut.phase;
+  uint64_t *phase_pn = scrut.phase_pn;
+  uint64_t *window = scrut.window;
+  uint32_t window_len = scrut.window_len;
+  EverCrypt_AEAD_state_s *next_aead;
+  if (next_keys)
+    next_aead = next_aead_state;
+  else
+    next_aead = NULL;
+  uint64_t last_pn = bpn[0U];
+  uint64_t ppn = *phase_pn;
+  EverQuic_status
   res =
     decrypt(aead_alg,
       aead_state,
       iv,
+      prev_aead_state,
+      prev_iv,
+      next_aead,
+      next_iv,
+      phase,
+      ppn,
       ctr_state,
-      hp_key,
       packet,
       len,
       dst,
       last_pn,
+      window,
+      window_len,
       (uint32_t)cid_len);
-  if (res == EverCrypt_Error_Success)
+  if (res == EverQuic_Ok)
   {
     EverQuic_result r = dst[0U];
     uint64_t pn = r.pn;
     uint64_t pn_ = max640(last_pn, pn);
     bpn[0U] = pn_;
+    if (window_len != 0U)
+      replay_update(window, window_len, last_pn, pn);
+    key_choice
+    keys = select_keys(!(prev_aead_state == NULL), !(next_aead == NULL), phase, ppn, r.header, pn);
+    if (keys == CurrentKeys)
+    {
+      uint64_t ppn_;
+      if (ppn == 0x3fffffffffffffffULL)
+        ppn_ = pn;
+      else
+        ppn_ = max640(ppn, pn);
+      phase_pn[0U] = ppn_;
+    }
   }
   return res;
 }
 
+EverQuic_status
+EverQuic_decrypt_no_key_update(
+  EverQuic_state_s *s,
+  EverQuic_result *dst,
+  uint8_t *packet,
+  uint32_t len,
+  uint8_t cid_len
+)
+{
+  return decrypt_core(s, false, dst, packet, len, cid_len);
+}
+
+uint8_t EverQuic_key_phase_of_state(EverQuic_state_s *s)
+{
+  uint8_t phase = (*s).phase;
+  return phase;
+}
+
+static bool has_next_keys(EverQuic_state_s *s)
+{
+  EverCrypt_AEAD_state_s *next_aead_state = (*s).next_aead_state;
+  return !(next_aead_state == NULL);
+}
+
+static void rotate(EverQuic_state_s *s, uint64_t ppn)
+{
+  EverQuic_state_s scrut = *s;
+  Spec_Hash_Definitions_hash_alg hash_alg = scrut.the_hash_alg;
+  Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
+  EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
+  uint8_t *iv = scrut.iv;
+  uint8_t *hp_key = scrut.hp_key;
+  uint64_t *pn = scrut.pn;
+  NotEverCrypt_CTR_state_s *ctr_state = scrut.ctr_state;
+  uint8_t *keys = scrut.keys;
+  uint8_t *secret = scrut.secret;
+  EverCrypt_AEAD_state_s *prev_aead_state = scrut.prev_aead_state;
+  uint8_t *prev_iv = scrut.prev_iv;
+  EverCrypt_AEAD_state_s *next_aead_state = scrut.next_aead_state;
+  uint8_t *next_iv = scrut.next_iv;
+  uint8_t phase = scrut.phase;
+  uint64_t *phase_pn = scrut.phase_pn;
+  uint64_t *window = scrut.window;
+  uint32_t window_len = scrut.window_len;
+  KRML_CHECK_SIZE(sizeof (uint8_t), hash_len32(hash_alg));
+  uint8_t next_secret[hash_len32(hash_alg)];
+  memset(next_secret, 0U, hash_len32(hash_alg) * sizeof (uint8_t));
+  derive_secret(hash_alg, next_secret, hash_len(hash_alg), secret, label_ku, 2U);
+  if (!(prev_aead_state == NULL))
+    EverCrypt_AEAD_free(prev_aead_state);
+  memcpy(prev_iv, iv, 12U * sizeof (uint8_t));
+  memcpy(iv, next_iv, 12U * sizeof (uint8_t));
+  Lib_Memzero0_memzero(next_iv, 12U, uint8_t, void *);
+  memcpy(secret, next_secret, hash_len32(hash_alg) * sizeof (uint8_t));
+  Lib_Memzero0_memzero(next_secret, hash_len32(hash_alg), uint8_t, void *);
+  *phase_pn = ppn;
+  s[0U]
+  =
+    (
+      (EverQuic_state_s){
+        .the_hash_alg = hash_alg,
+        .the_aead_alg = aead_alg,
+        .aead_state = next_aead_state,
+        .iv = iv,
+        .hp_key = hp_key,
+        .pn = pn,
+        .ctr_state = ctr_state,
+        .keys = keys,
+        .secret = secret,
+        .prev_aead_state = aead_state,
+        .prev_iv = prev_iv,
+        .next_aead_state = NULL,
+        .next_iv = next_iv,
+        .phase = 1U - (uint32_t)phase,
+        .phase_pn = phase_pn,
+        .window = window,
+        .window_len = window_len
+      }
+    );
+}
+
+EverCrypt_Error_error_code EverQuic_key_update(EverQuic_state_s *s)
+{
+  if (!has_next_keys(s))
+    create_next_keys(s);
+  if (has_next_keys(s))
+  {
+    rotate(s, 0x3fffffffffffffffULL);
+    return EverCrypt_Error_Success;
+  }
+  else
+    return EverCrypt_Error_UnsupportedAlgorithm;
+}
+
+void EverQuic_discard_previous_keys(EverQuic_state_s *s)
+{
+  EverQuic_state_s scrut = *s;
+  Spec_Hash_Definitions_hash_alg hash_alg = scrut.the_hash_alg;
+  Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
+  EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
+  uint8_t *iv = scrut.iv;
+  uint8_t *hp_key = scrut.hp_key;
+  uint64_t *pn = scrut.pn;
+  NotEverCrypt_CTR_state_s *ctr_state = scrut.ctr_state;
+  uint8_t *keys = scrut.keys;
+  uint8_t *secret = scrut.secret;
+  EverCrypt_AEAD_state_s *prev_aead_state = scrut.prev_aead_state;
+  uint8_t *prev_iv = scrut.prev_iv;
+  EverCrypt_AEAD_state_s *next_aead_state = scrut.next_aead_state;
+  uint8_t *next_iv = scrut.next_iv;
+  uint8_t phase = scrut.phase;
+  uint64_t *phase_pn = scrut.phase_pn;
+  uint64_t *window = scrut.window;
+  uint32_t window_len = scrut.window_len;
+  if (!(prev_aead_state == NULL))
+  {
+    Lib_Memzero0_memzero(prev_iv, 12U, uint8_t, void *);
+    EverCrypt_AEAD_free(prev_aead_state);
+    s[0U]
+    =
+      (
+        (EverQuic_state_s){
+          .the_hash_alg = hash_alg,
+          .the_aead_alg = aead_alg,
+          .aead_state = aead_state,
+          .iv = iv,
+          .hp_key = hp_key,
+          .pn = pn,
+          .ctr_state = ctr_state,
+          .keys = keys,
+          .secret = secret,
+          .prev_aead_state = NULL,
+          .prev_iv = prev_iv,
+          .next_aead_state = next_aead_state,
+          .next_iv = next_iv,
+          .phase = phase,
+          .phase_pn = phase_pn,
+          .window = window,
+          .window_len = window_len
+        }
+      );
+  }
+}
+
+EverQuic_status
+EverQuic_decrypt(
+  EverQuic_state_s *s,
+  EverQuic_result *dst,
+  uint8_t *packet,
+  uint32_t len,
+  uint8_t cid_len
+)
+{
+  if (len != 0U && (packet[0U] & 0x80U) == 0U && !has_next_keys(s))
+    create_next_keys(s);
+  EverQuic_state_s scrut = *s;
+  EverCrypt_AEAD_state_s *prev_aead_state = scrut.prev_aead_state;
+  EverCrypt_AEAD_state_s *next_aead_state = scrut.next_aead_state;
+  uint8_t phase = scrut.phase;
+  uint64_t *phase_pn = scrut.phase_pn;
+  uint64_t ppn = *phase_pn;
+  EverQuic_status res = decrypt_core(s, true, dst, packet, len, cid_len);
+  if (res == EverQuic_Ok && !(next_aead_state == NULL))
+  {
+    EverQuic_result result = dst[0U];
+    key_choice
+    keys = select_keys(!(prev_aead_state == NULL), true, phase, ppn, result.header, result.pn);
+    if (keys == NextKeys)
+    {
+      rotate(s, result.pn);
+      create_next_keys(s);
+    }
+  }
+  return res;
+}
+
+void
+EverQuic_encrypt_batch(EverQuic_state_s *s, EverQuic_encrypt_desc *descs, uint32_t n)
+{
+  EverQuic_state_s scrut = *s;
+  Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
+  EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
+  uint8_t *iv = scrut.iv;
+  uint64_t *bpn = scrut.pn;
+  NotEverCrypt_CTR_state_s *ctr_state = scrut.ctr_state;
+  for (uint32_t i = 0U; i < n; i++)
+  {
+    EverQuic_encrypt_desc d = descs[i];
+    uint64_t last_pn = bpn[0U];
+    uint64_t pn = last_pn + 1ULL;
+    bpn[0U] = pn;
+    EverCrypt_Error_error_code
+    err = encrypt(aead_alg, aead_state, iv, ctr_state, d.dst, d.hdr, pn, d.plain, d.plain_length);
+    descs[i]
+    =
+      (
+        (EverQuic_encrypt_desc){
+          .dst = d.dst,
+          .hdr = d.hdr,
+          .plain = d.plain,
+          .plain_length = d.plain_length,
+          .assigned_pn = pn,
+          .err = err
+        }
+      );
+  }
+}
+
+void
+EverQuic_decrypt_batch(
+  EverQuic_state_s *s,
+  EverQuic_decrypt_desc *descs,
+  uint32_t n,
+  uint8_t cid_len
+)
+{
+  if (!(n == 0U))
+  {
+    EverQuic_result dst = descs[0U].res;
+    for (uint32_t i = 0U; i < n; i++)
+    {
+      EverQuic_decrypt_desc d = descs[i];
+      EverQuic_status err;
+      if (EverQuic_last_packet_number_of_state(s) < 0x3fffffffffffffffULL)
+        err = EverQuic_decrypt(s, &dst, d.packet, d.packet_len, cid_len);
+      else
+        err = EverQuic_Malformed;
+      descs[i]
+      =
+        (
+          (EverQuic_decrypt_desc){
+            .packet = d.packet,
+            .packet_len = d.packet_len,
+            .res = dst,
+            .err = err
+          }
+        );
+    }
+  }
+}
+
+static EverQuic_status
+decrypt_epoch(
+  bool next_keys,
+  EverQuic_state_s *s,
+  EverQuic_result *dst,
+  uint8_t *packet,
+  uint32_t len,
+  uint8_t cid_len
+)
+{
+  if (s == NULL)
+    return EverQuic_NoKeys;
+  else
+  {
+    EverQuic_state_s scrut = *s;
+    uint64_t *bpn = scrut.pn;
+    if (bpn[0U] < 0x3fffffffffffffffULL)
+      if (next_keys)
+        return EverQuic_decrypt(s, dst, packet, len, cid_len);
+      else
+        return EverQuic_decrypt_no_key_update(s, dst, packet, len, cid_len);
+    else
+      return EverQuic_Malformed;
+  }
+}
+
+static uint32_t long_packet_len(uint8_t *packet, uint32_t len, uint8_t cid_len)
+{
+  uint32_t cid_len1 = (uint32_t)cid_len;
+  LowParse_Slice_slice input = { .base = packet, .len = len };
+  if (LowParse_Low_ErrorCode_is_error(validate_header(cid_len1, input, 0ULL)))
+    return 0U;
+  else
+  {
+    header ph = read_header(packet, len, cid_len1);
+    if (ph.tag == PLong)
+    {
+      long_header_specifics spec = ph.case_PLong.spec;
+      uint64_t pl;
+      if (spec.tag == PInitial)
+        pl = spec.case_PInitial.payload_and_pn_length;
+      else if (spec.tag == PZeroRTT)
+        pl = spec.case_PZeroRTT;
+      else if (spec.tag == PHandshake)
+        pl = spec.case_PHandshake;
+      else if (spec.tag == PRetry)
+        pl = 0ULL;
+      else
+      {
+        KRML_HOST_EPRINTF("KaRaMeL incomplete match at %s:%d\n", __FILE__, __LINE__);
+        KRML_HOST_EXIT(253U);
+      }
+      uint32_t hl = header_len(ph);
+      if (pl == 0ULL || hl > len || pl > (uint64_t)(len - hl))
+        return 0U;
+      else
+        return hl + (uint32_t)pl;
+    }
+    else
+      return 0U;
+  }
+}
+
+uint32_t
+EverQuic_decrypt_datagram(
+  EverQuic_epoch_states ss,
+  EverQuic_decrypt_desc *descs,
+  uint32_t n,
+  uint8_t *datagram,
+  uint32_t len,
+  uint8_t cid_len
+)
+{
+  if (n == 0U)
+    return 0U;
+  else
+  {
+    uint32_t off = 0U;
+    uint32_t count = 0U;
+    EverQuic_result dst = descs[0U].res;
+    for (uint32_t i = 0U; i < n; i++)
+    {
+      uint32_t o = off;
+      if (count == i && o < len)
+      {
+        uint32_t rem = len - o;
+        uint8_t *packet = datagram + o;
+        uint8_t flags = packet[0U];
+        EverQuic_status err;
+        if (((uint32_t)flags & 0x80U) == 0U)
+          err = decrypt_epoch(true, ss.one_rtt, &dst, packet, rem, cid_len);
+        else
+        {
+          uint8_t ty = (uint32_t)(uint8_t)((uint32_t)flags >> 4U) & 3U;
+          if (ty == 1U)
+            err = decrypt_epoch(false, ss.zero_rtt, &dst, packet, rem, cid_len);
+          else if (ty == 2U)
+            err = decrypt_epoch(false, ss.handshake, &dst, packet, rem, cid_len);
+          else
+            err = decrypt_epoch(false, ss.initial, &dst, packet, rem, cid_len);
+        }
+        EverQuic_result r = dst;
+        uint32_t total;
+        switch (err)
+        {
+          case EverQuic_Ok:
+            {
+              total = r.total_len;
+              break;
+            }
+          case EverQuic_Unauthenticated:
+            {
+              total = r.total_len;
+              break;
+            }
+          case EverQuic_Replayed:
+            {
+              total = r.total_len;
+              break;
+            }
+          case EverQuic_NoKeys:
+            {
+              if (((uint32_t)flags & 0x80U) != 0U)
+                total = long_packet_len(packet, rem, cid_len);
+              else
+                total = 0U;
+              break;
+            }
+          case EverQuic_Malformed:
+            {
+              total = 0U;
+              break;
+            }
+          default:
+            {
+              KRML_HOST_EPRINTF("KaRaMeL incomplete match at %s:%d\n", __FILE__, __LINE__);
+              KRML_HOST_EXIT(253U);
+            }
+        }
+        uint32_t plen;
+        if (total == 0U)
+          plen = rem;
+        else
+          plen = total;
+        descs[i]
+        =
+          (
+            (EverQuic_decrypt_desc){
+              .packet = packet,
+              .packet_len = plen,
+              .res = r,
+              .err = err
+            }
+          );
+        count = i + 1U;
+        uint32_t ite;
+        if (total == 0U)
+          ite = len;
+        else
+          ite = o + total;
+        off = ite;
+      }
+    }
+    return count;
+  }
+}
+
+typedef struct EverQuic_cursor_s_s
+{
+  NotEverCrypt_CTR_state_s *hp_state;
+  uint64_t *last_pn;
+}
+EverQuic_cursor_s;
+
+EverQuic_status EverQuic_cursor_create_in(EverQuic_state_s *s, EverQuic_cursor_s **dst)
+{
+  EverQuic_state_s scrut = *s;
+  Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
+  uint8_t *hp_key = scrut.hp_key;
+  uint64_t *bpn = scrut.pn;
+  uint32_t window_len = scrut.window_len;
+  if (window_len != 0U)
+    return EverQuic_HasReplayWindow;
+  else
+  {
+    if (!has_next_keys(s))
+      create_next_keys(s);
+    NotEverCrypt_CTR_state_s *ctr_state = NULL;
+    uint8_t dummy_iv[12U] = { 0U };
+    EverCrypt_Error_error_code
+    ret =
+      NotEverCrypt_CTR_create_in(Spec_Agile_AEAD_cipher_alg_of_supported_alg(aead_alg),
+        &ctr_state,
+        hp_key,
+        dummy_iv,
+        12U,
+        0U);
+    EverQuic_status ret0;
+    if (ret == EverCrypt_Error_Success)
+    {
+      uint64_t pn = QUIC_Atomic_load(bpn);
+      uint64_t *last_pn = KRML_HOST_MALLOC(sizeof (uint64_t));
+      last_pn[0U] = pn;
+      EverQuic_cursor_s *c = KRML_HOST_MALLOC(sizeof (EverQuic_cursor_s));
+      c[0U] = ((EverQuic_cursor_s){ .hp_state = ctr_state, .last_pn = last_pn });
+      *dst = c;
+      ret0 = EverQuic_Ok;
+    }
+    else
+      ret0 = EverQuic_Unsupported;
+    return ret0;
+  }
+}
+
+void EverQuic_cursor_free(EverQuic_cursor_s *c)
+{
+  EverQuic_cursor_s cs = *c;
+  NotEverCrypt_CTR_free(cs.hp_state);
+  KRML_HOST_FREE(cs.last_pn);
+  KRML_HOST_FREE(c);
+}
+
+EverCrypt_Error_error_code
+EverQuic_cursor_encrypt(
+  EverQuic_state_s *s,
+  EverQuic_cursor_s *c,
+  uint8_t *dst,
+  uint64_t *dst_pn,
+  EverQuic_header h,
+  uint8_t *plain,
+  uint32_t plain_len
+)
+{
+  EverQuic_state_s scrut = *s;
+  Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
+  EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
+  uint8_t *iv = scrut.iv;
+  uint64_t *bpn = scrut.pn;
+  EverQuic_cursor_s cs = *c;
+  uint64_t pn = QUIC_Atomic_fetch_incr(bpn) + 1ULL;
+  dst_pn[0U] = pn;
+  return encrypt(aead_alg, aead_state, iv, cs.hp_state, dst, h, pn, plain, plain_len);
+}
+
+EverQuic_status
+EverQuic_cursor_decrypt(
+  EverQuic_state_s *s,
+  EverQuic_cursor_s *c,
+  EverQuic_result *dst,
+  uint8_t *packet,
+  uint32_t len,
+  uint8_t cid_len
+)
+{
+  EverQuic_state_s scrut = *s;
+  Spec_Agile_AEAD_alg aead_alg = scrut.the_aead_alg;
+  EverCrypt_AEAD_state_s *aead_state = scrut.aead_state;
+  uint8_t *iv = scrut.iv;
+  EverCrypt_AEAD_state_s *prev_aead_state = scrut.prev_aead_state;
+  uint8_t *prev_iv = scrut.prev_iv;
+  EverCrypt_AEAD_state_s *next_aead_state = scrut.next_aead_state;
+  uint8_t *next_iv = scrut.next_iv;
+  uint8_t phase = scrut.phase;
+  uint64_t *phase_pn = scrut.phase_pn;
+  EverQuic_cursor_s cs = *c;
+  uint64_t last_pn = *cs.last_pn;
+  EverQuic_status
+  res =
+    decrypt(aead_alg,
+      aead_state,
+      iv,
+      prev_aead_state,
+      prev_iv,
+      next_aead_state,
+      next_iv,
+      phase,
+      *phase_pn,
+      cs.hp_state,
+      packet,
+      len,
+      dst,
+      last_pn,
+      NULL,
+      0U,
+      (uint32_t)cid_len);
+  if (res == EverQuic_Ok)
+  {
+    EverQuic_result r = dst[0U];
+    cs.last_pn[0U] = max640(last_pn, r.pn);
+  }
+  return res;
+}
+
+EverCrypt_Error_error_code
+EverQuic_create_initial_in(
+  EverQuic_state_s **dst_client,
+  EverQuic_state_s **dst_server,
+  uint8_t *cid,
+  uint32_t cid_len
+)
+{
+  uint8_t secrets[64U] = { 0U };
+  uint8_t *client_secret = secrets;
+  uint8_t *server_secret = secrets + 32U;
+  EverQuic_initial_secrets(client_secret, server_secret, cid, cid_len);
+  EverCrypt_Error_error_code
+  ret =
+    EverQuic_create_in((
+        (EverQuic_index){
+          .hash_alg = Spec_Hash_Definitions_SHA2_256,
+          .aead_alg = Spec_Agile_AEAD_AES128_GCM
+        }
+      ),
+      dst_client,
+      0ULL,
+      client_secret);
+  EverCrypt_Error_error_code ret0;
+  if (ret == EverCrypt_Error_Success)
+  {
+    EverCrypt_Error_error_code
+    ret_ =
+      EverQuic_create_in((
+          (EverQuic_index){
+            .hash_alg = Spec_Hash_Definitions_SHA2_256,
+            .aead_alg = Spec_Agile_AEAD_AES128_GCM
+          }
+        ),
+        dst_server,
+        0ULL,
+        server_secret);
+    if (ret_ != EverCrypt_Error_Success)
+      EverQuic_free(*dst_client);
+    ret0 = ret_;
+  }
+  else
+    ret0 = ret;
+  Lib_Memzero0_memzero(secrets, 64U, uint8_t, void *);
+  return ret0;
+}
+
+typedef struct initial_cache_entry_s
+{
+  uint32_t cid_len;
+  EverQuic_state_s *client;
+  EverQuic_state_s *server;
+  bool pinned;
+  uint64_t last_use;
+}
+initial_cache_entry;
+
+typedef struct EverQuic_initial_cache_s_s
+{
+  uint32_t n_sets;
+  uint32_t seed;
+  uint8_t *cids;
+  initial_cache_entry *entries;
+  uint64_t *counters;
+}
+EverQuic_initial_cache_s;
+
+EverQuic_initial_cache_s *EverQuic_initial_cache_create_in(uint32_t n_sets, uint32_t seed)
+{
+  KRML_CHECK_SIZE(sizeof (uint8_t), 20U * (4U * n_sets));
+  uint8_t *cids = KRML_HOST_CALLOC(20U * (4U * n_sets), sizeof (uint8_t));
+  KRML_CHECK_SIZE(sizeof (initial_cache_entry), 4U * n_sets);
+  initial_cache_entry *entries = KRML_HOST_MALLOC(sizeof (initial_cache_entry) * (4U * n_sets));
+  for (uint32_t _i = 0U; _i < 4U * n_sets; ++_i)
+    entries[_i]
+    =
+      (
+        (initial_cache_entry){
+          .cid_len = 0U,
+          .client = NULL,
+          .server = NULL,
+          .pinned = false,
+          .last_use = 0ULL
+        }
+      );
+  uint64_t *counters = KRML_HOST_CALLOC(3U, sizeof (uint64_t));
+  EverQuic_initial_cache_s
+  c =
+    {
+      .n_sets = n_sets, .seed = seed, .cids = cids, .entries = entries, .counters = counters
+    };
+  EverQuic_initial_cache_s *c1 = KRML_HOST_MALLOC(sizeof (EverQuic_initial_cache_s));
+  c1[0U] = c;
+  return c1;
+}
+
+static uint32_t hash_cid(uint32_t seed, uint8_t *cid, uint32_t cid_len)
+{
+  uint32_t h = 0x811c9dc5U ^ seed;
+  for (uint32_t i = 0U; i < cid_len; i++)
+  {
+    uint32_t b = (uint32_t)cid[i];
+    h = (h ^ b) * 0x01000193U;
+  }
+  return h;
+}
+
+static bool cid_equal(uint8_t *a, uint8_t *b, uint32_t len)
+{
+  bool r = true;
+  for (uint32_t i = 0U; i < len; i++)
+    if (a[i] != b[i])
+      r = false;
+  return r;
+}
+
+static uint32_t
+find_way(EverQuic_initial_cache_s c, uint32_t base, uint8_t *cid, uint32_t cid_len)
+{
+  uint32_t way = 4U;
+  for (uint32_t i = 0U; i < 4U; i++)
+  {
+    initial_cache_entry e = c.entries[base + i];
+    if (!(e.client == NULL) && e.cid_len == cid_len)
+      if (cid_equal(c.cids + 20U * (base + i), cid, cid_len))
+        way = i;
+  }
+  return way;
+}
+
+EverCrypt_Error_error_code
+EverQuic_initial_cache_find(
+  EverQuic_initial_cache_s *c,
+  uint8_t *cid,
+  uint32_t cid_len,
+  EverQuic_state_s **dst_client,
+  EverQuic_state_s **dst_server,
+  bool *created
+)
+{
+  EverQuic_initial_cache_s cs = *c;
+  uint32_t base = 4U * (hash_cid(cs.seed, cid, cid_len) % cs.n_sets);
+  uint64_t now = cs.counters[0U] + 1ULL;
+  cs.counters[0U] = now;
+  uint32_t w = find_way(cs, base, cid, cid_len);
+  if (w != 4U)
+  {
+    uint32_t j = base + w;
+    initial_cache_entry e = cs.entries[j];
+    cs.entries[j]
+    =
+      (
+        (initial_cache_entry){
+          .cid_len = e.cid_len,
+          .client = e.client,
+          .server = e.server,
+          .pinned = e.pinned,
+          .last_use = now
+        }
+      );
+    cs.counters[1U] = cs.counters[1U] + 1ULL;
+    *dst_client = e.client;
+    *dst_server = e.server;
+    *created = false;
+    return EverCrypt_Error_Success;
+  }
+  else
+  {
+    cs.counters[2U] = cs.counters[2U] + 1ULL;
+    uint32_t victim = 4U;
+    for (uint32_t i = 0U; i < 4U; i++)
+    {
+      uint32_t v = victim;
+      initial_cache_entry e = cs.entries[base + i];
+      if (!e.pinned && (v == 4U || e.last_use < cs.entries[base + v].last_use))
+        victim = i;
+    }
+    uint32_t w0 = victim;
+    if (w0 == 4U)
+      return EverCrypt_Error_MaximumLengthExceeded;
+    else
+    {
+      EverCrypt_Error_error_code
+      ret = EverQuic_create_initial_in(dst_client, dst_server, cid, cid_len);
+      if (ret == EverCrypt_Error_Success)
+      {
+        uint32_t j = base + w0;
+        initial_cache_entry e = cs.entries[j];
+        if (!(e.client == NULL))
+        {
+          EverQuic_free(e.client);
+          EverQuic_free(e.server);
+        }
+        memcpy(cs.cids + 20U * j, cid, cid_len * sizeof (uint8_t));
+        cs.entries[j]
+        =
+          (
+            (initial_cache_entry){
+              .cid_len = cid_len,
+              .client = *dst_client,
+              .server = *dst_server,
+              .pinned = false,
+              .last_use = now
+            }
+          );
+        *created = true;
+      }
+      return ret;
+    }
+  }
+}
+
+bool
+EverQuic_initial_cache_pin(
+  EverQuic_initial_cache_s *c,
+  uint8_t *cid,
+  uint32_t cid_len,
+  bool pinned
+)
+{
+  EverQuic_initial_cache_s cs = *c;
+  uint32_t base = 4U * (hash_cid(cs.seed, cid, cid_len) % cs.n_sets);
+  uint32_t w = find_way(cs, base, cid, cid_len);
+  if (w != 4U)
+  {
+    uint32_t j = base + w;
+    initial_cache_entry e = cs.entries[j];
+    cs.entries[j]
+    =
+      (
+        (initial_cache_entry){
+          .cid_len = e.cid_len,
+          .client = e.client,
+          .server = e.server,
+          .pinned = pinned,
+          .last_use = e.last_use
+        }
+      );
+    return true;
+  }
+  else
+    return false;
+}
+
+bool EverQuic_initial_cache_remove(EverQuic_initial_cache_s *c, uint8_t *cid, uint32_t cid_len)
+{
+  EverQuic_initial_cache_s cs = *c;
+  uint32_t base = 4U * (hash_cid(cs.seed, cid, cid_len) % cs.n_sets);
+  uint32_t w = find_way(cs, base, cid, cid_len);
+  if (w != 4U)
+  {
+    uint32_t j = base + w;
+    initial_cache_entry e = cs.entries[j];
+    EverQuic_free(e.client);
+    EverQuic_free(e.server);
+    cs.entries[j]
+    =
+      (
+        (initial_cache_entry){
+          .cid_len = 0U,
+          .client = NULL,
+          .server = NULL,
+          .pinned = false,
+          .last_use = 0ULL
+        }
+      );
+    return true;
+  }
+  else
+    return false;
+}
+
+uint64_t EverQuic_initial_cache_hits(EverQuic_initial_cache_s *c)
+{
+  EverQuic_initial_cache_s cs = *c;
+  return cs.counters[1U];
+}
+
+uint64_t EverQuic_initial_cache_misses(EverQuic_initial_cache_s *c)
+{
+  EverQuic_initial_cache_s cs = *c;
+  return cs.counters[2U];
+}
+
+void EverQuic_initial_cache_free(EverQuic_initial_cache_s *c)
+{
+  EverQuic_initial_cache_s cs = *c;
+  for (uint32_t i = 0U; i < 4U * cs.n_sets; i++)
+  {
+    initial_cache_entry e = cs.entries[i];
+    if (!(e.client == NULL))
+    {
+      EverQuic_free(e.client);
+      EverQuic_free(e.server);
+    }
+  }
+  KRML_HOST_FREE(cs.cids);
+  KRML_HOST_FREE(cs.entries);
+  KRML_HOST_FREE(cs.counters);
+  KRML_HOST_FREE(c);
+}
+
 bool EverQuic_uu___is_BInitial(EverQuic_long_header_specifics projectee)
 {
   if (projectee.tag == EverQuic_BInitial)
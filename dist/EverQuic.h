@@ -103,6 +103,24 @@ typedef struct EverQuic_result_s
 }
 EverQuic_result;
 
+#define EverQuic_Ok 0
+#define EverQuic_Malformed 1
+#define EverQuic_Unauthenticated 2
+#define EverQuic_Replayed 3
+#define EverQuic_NoKeys 4
+#define EverQuic_Unsupported 5
+#define EverQuic_InvalidWindowSize 6
+#define EverQuic_HasReplayWindow 7
+
+typedef uint8_t EverQuic_status;
+
+typedef struct EverQuic_iovec_s
+{
+  uint8_t *iov_base;
+  uint32_t iov_len;
+}
+EverQuic_iovec;
+
 typedef struct EverQuic_index_s
 {
   Spec_Hash_Definitions_hash_alg hash_alg;
@@ -120,6 +138,12 @@ typedef void *EverQuic_invariant_s;
 
 typedef void *EverQuic_invariant;
 
+typedef void *EverQuic_freeable_s;
+
+typedef void *EverQuic_freeable;
+
+typedef void *EverQuic_preserves_freeable;
+
 Spec_Agile_AEAD_alg EverQuic_aead_alg_of_state(EverQuic_state_s *s);
 
 Spec_Hash_Definitions_hash_alg EverQuic_hash_alg_of_state(EverQuic_state_s *s);
@@ -134,6 +158,19 @@ EverQuic_create_in(
   uint8_t *traffic_secret
 );
 
+bool EverQuic_valid_window_bits(uint32_t window_bits);
+
+EverQuic_status
+EverQuic_create_in_with_replay_window(
+  EverQuic_index i,
+  EverQuic_state_s **dst,
+  uint64_t initial_pn,
+  uint8_t *traffic_secret,
+  uint32_t window_bits
+);
+
+void EverQuic_free(EverQuic_state_s *s);
+
 EverCrypt_Error_error_code
 EverQuic_encrypt(
   EverQuic_state_s *s,
@@ -144,6 +181,16 @@ EverQuic_encrypt(
   uint32_t plain_len
 );
 
+EverCrypt_Error_error_code
+EverQuic_encrypt_gather(
+  EverQuic_state_s *s,
+  uint8_t *dst,
+  uint64_t *dst_pn,
+  EverQuic_header h,
+  EverQuic_iovec *plain,
+  uint32_t plain_count
+);
+
 void
 EverQuic_initial_secrets(
   uint8_t *dst_client,
@@ -152,9 +199,11 @@ EverQuic_initial_secrets(
   uint32_t cid_len
 );
 
+typedef void *EverQuic_decrypt_result_post;
+
 typedef void *EverQuic_decrypt_post;
 
-EverCrypt_Error_error_code
+EverQuic_status
 EverQuic_decrypt(
   EverQuic_state_s *s,
   EverQuic_result *dst,
@@ -163,6 +212,178 @@ EverQuic_decrypt(
   uint8_t cid_len
 );
 
+EverQuic_status
+EverQuic_decrypt_no_key_update(
+  EverQuic_state_s *s,
+  EverQuic_result *dst,
+  uint8_t *packet,
+  uint32_t len,
+  uint8_t cid_len
+);
+
+uint8_t EverQuic_key_phase_of_state(EverQuic_state_s *s);
+
+EverCrypt_Error_error_code EverQuic_key_update(EverQuic_state_s *s);
+
+void EverQuic_discard_previous_keys(EverQuic_state_s *s);
+
+typedef struct EverQuic_encrypt_desc_s
+{
+  uint8_t *dst;
+  EverQuic_header hdr;
+  uint8_t *plain;
+  uint32_t plain_length;
+  uint64_t assigned_pn;
+  EverCrypt_Error_error_code err;
+}
+EverQuic_encrypt_desc;
+
+typedef void *EverQuic_encrypt_desc_pre;
+
+void
+EverQuic_encrypt_batch(EverQuic_state_s *s, EverQuic_encrypt_desc *descs, uint32_t n);
+
+typedef struct EverQuic_decrypt_desc_s
+{
+  uint8_t *packet;
+  uint32_t packet_len;
+  EverQuic_result res;
+  EverQuic_status err;
+}
+EverQuic_decrypt_desc;
+
+typedef void *EverQuic_decrypt_desc_pre;
+
+void
+EverQuic_decrypt_batch(
+  EverQuic_state_s *s,
+  EverQuic_decrypt_desc *descs,
+  uint32_t n,
+  uint8_t cid_len
+);
+
+typedef struct EverQuic_epoch_states_s
+{
+  EverQuic_state_s *initial;
+  EverQuic_state_s *zero_rtt;
+  EverQuic_state_s *handshake;
+  EverQuic_state_s *one_rtt;
+}
+EverQuic_epoch_states;
+
+typedef void *EverQuic_epoch_invariant;
+
+typedef void *EverQuic_epochs_invariant;
+
+uint32_t
+EverQuic_decrypt_datagram(
+  EverQuic_epoch_states ss,
+  EverQuic_decrypt_desc *descs,
+  uint32_t n,
+  uint8_t *datagram,
+  uint32_t len,
+  uint8_t cid_len
+);
+
+typedef struct EverQuic_cursor_s_s EverQuic_cursor_s;
+
+typedef EverQuic_cursor_s *EverQuic_cursor;
+
+typedef void *EverQuic_cursor_invariant_s;
+
+typedef void *EverQuic_cursor_invariant;
+
+typedef void *EverQuic_cursor_freeable_s;
+
+typedef void *EverQuic_cursor_freeable;
+
+EverQuic_status EverQuic_cursor_create_in(EverQuic_state_s *s, EverQuic_cursor_s **dst);
+
+void EverQuic_cursor_free(EverQuic_cursor_s *c);
+
+EverCrypt_Error_error_code
+EverQuic_cursor_encrypt(
+  EverQuic_state_s *s,
+  EverQuic_cursor_s *c,
+  uint8_t *dst,
+  uint64_t *dst_pn,
+  EverQuic_header h,
+  uint8_t *plain,
+  uint32_t plain_len
+);
+
+/**
+Never rotates the keys of s. A packet protected with the next generation
+of keys is accepted, with a Key Phase bit that differs from
+EverQuic_key_phase_of_state(s). Once no other thread uses s, the owner of s
+must pass a copy of such a packet to EverQuic_decrypt, which rotates the keys.
+Until then, packets of a second key update of the peer fail with
+EverQuic_Unauthenticated.
+*/
+EverQuic_status
+EverQuic_cursor_decrypt(
+  EverQuic_state_s *s,
+  EverQuic_cursor_s *c,
+  EverQuic_result *dst,
+  uint8_t *packet,
+  uint32_t len,
+  uint8_t cid_len
+);
+
+typedef EverQuic_state_s *EverQuic_initial_state;
+
+EverCrypt_Error_error_code
+EverQuic_create_initial_in(
+  EverQuic_state_s **dst_client,
+  EverQuic_state_s **dst_server,
+  uint8_t *cid,
+  uint32_t cid_len
+);
+
+typedef struct EverQuic_initial_cache_s_s EverQuic_initial_cache_s;
+
+typedef EverQuic_initial_cache_s *EverQuic_initial_cache;
+
+typedef void *EverQuic_cache_invariant_s;
+
+typedef void *EverQuic_cache_invariant;
+
+typedef void *EverQuic_cache_freeable_s;
+
+typedef void *EverQuic_cache_freeable;
+
+typedef void *EverQuic_cache_holds;
+
+typedef void *EverQuic_cache_pinned;
+
+EverQuic_initial_cache_s *EverQuic_initial_cache_create_in(uint32_t n_sets, uint32_t seed);
+
+EverCrypt_Error_error_code
+EverQuic_initial_cache_find(
+  EverQuic_initial_cache_s *c,
+  uint8_t *cid,
+  uint32_t cid_len,
+  EverQuic_state_s **dst_client,
+  EverQuic_state_s **dst_server,
+  bool *created
+);
+
+bool
+EverQuic_initial_cache_pin(
+  EverQuic_initial_cache_s *c,
+  uint8_t *cid,
+  uint32_t cid_len,
+  bool pinned
+);
+
+bool EverQuic_initial_cache_remove(EverQuic_initial_cache_s *c, uint8_t *cid, uint32_t cid_len);
+
+uint64_t EverQuic_initial_cache_hits(EverQuic_initial_cache_s *c);
+
+uint64_t EverQuic_initial_cache_misses(EverQuic_initial_cache_s *c);
+
+void EverQuic_initial_cache_free(EverQuic_initial_cache_s *c);
+
 bool EverQuic_uu___is_BInitial(EverQuic_long_header_specifics projectee);
 
 bool EverQuic_uu___is_BZeroRTT(EverQuic_long_header_specifics projectee);
@@ -4,6 +4,7 @@
 
 #include "internal/LowStar.h"
 #include "internal/EverQuic_Krmllib.h"
+#include "lib_memzero0.h"
 
 typedef Prims_list__uint8_t *bytes;
 
@@ -313,6 +314,7 @@ typedef struct NotEverCrypt_CTR_state_s_s
   uint32_t iv_len;
   uint8_t *xkey;
   uint32_t ctr;
+  uint8_t *block;
 }
 NotEverCrypt_CTR_state_s;
 
@@ -365,12 +367,13 @@ NotEverCrypt_CTR_create_in(
           #if EVERCRYPT_TARGETCONFIG_HACL_CAN_COMPILE_VALE
           if (has_aesni && has_pclmulqdq && has_avx && has_sse)
           {
-            uint8_t *ek = KRML_HOST_CALLOC(304U, sizeof (uint8_t));
+            uint8_t *block = KRML_HOST_CALLOC(16U + 304U, sizeof (uint8_t));
+            uint8_t *iv_ = block;
+            uint8_t *ek = block + 16U;
             uint8_t *keys_b = ek;
             uint8_t *hkeys_b = ek + 176U;
             aes128_key_expansion(k, keys_b);
             aes128_keyhash_init(keys_b, hkeys_b);
-            uint8_t *iv_ = KRML_HOST_CALLOC(16U, sizeof (uint8_t));
             memcpy(iv_, iv, iv_len * sizeof (uint8_t));
             NotEverCrypt_CTR_state_s *p = KRML_HOST_MALLOC(sizeof (NotEverCrypt_CTR_state_s));
             p[0U]
@@ -381,7 +384,8 @@ NotEverCrypt_CTR_create_in(
                   .iv = iv_,
                   .iv_len = iv_len,
                   .xkey = ek,
-                  .ctr = c
+                  .ctr = c,
+                  .block = block
                 }
               );
             *dst = p;
@@ -409,12 +413,13 @@ NotEverCrypt_CTR_create_in(
           #if EVERCRYPT_TARGETCONFIG_HACL_CAN_COMPILE_VALE
           if (has_aesni && has_pclmulqdq && has_avx && has_sse)
           {
-            uint8_t *ek = KRML_HOST_CALLOC(368U, sizeof (uint8_t));
+            uint8_t *block = KRML_HOST_CALLOC(16U + 368U, sizeof (uint8_t));
+            uint8_t *iv_ = block;
+            uint8_t *ek = block + 16U;
             uint8_t *keys_b = ek;
             uint8_t *hkeys_b = ek + 240U;
             aes256_key_expansion(k, keys_b);
             aes256_keyhash_init(keys_b, hkeys_b);
-            uint8_t *iv_ = KRML_HOST_CALLOC(16U, sizeof (uint8_t));
             memcpy(iv_, iv, iv_len * sizeof (uint8_t));
             NotEverCrypt_CTR_state_s *p = KRML_HOST_MALLOC(sizeof (NotEverCrypt_CTR_state_s));
             p[0U]
@@ -425,7 +430,8 @@ NotEverCrypt_CTR_create_in(
                   .iv = iv_,
                   .iv_len = iv_len,
                   .xkey = ek,
-                  .ctr = c
+                  .ctr = c,
+                  .block = block
                 }
               );
             *dst = p;
@@ -438,10 +444,10 @@ NotEverCrypt_CTR_create_in(
       }
     case Spec_Agile_Cipher_CHACHA20:
       {
-        uint8_t *ek = KRML_HOST_CALLOC(32U, sizeof (uint8_t));
+        uint8_t *block = KRML_HOST_CALLOC(12U + 32U, sizeof (uint8_t));
+        uint8_t *iv_ = block;
+        uint8_t *ek = block + 12U;
         memcpy(ek, k, 32U * sizeof (uint8_t));
-        KRML_CHECK_SIZE(sizeof (uint8_t), iv_len);
-        uint8_t *iv_ = KRML_HOST_CALLOC(iv_len, sizeof (uint8_t));
         memcpy(iv_, iv, iv_len * sizeof (uint8_t));
         NotEverCrypt_CTR_state_s *p = KRML_HOST_MALLOC(sizeof (NotEverCrypt_CTR_state_s));
         p[0U]
@@ -452,7 +458,8 @@ NotEverCrypt_CTR_create_in(
               .iv = iv_,
               .iv_len = 12U,
               .xkey = ek,
-              .ctr = c
+              .ctr = c,
+              .block = block
             }
           );
         *dst = p;
@@ -467,53 +474,25 @@ NotEverCrypt_CTR_create_in(
 }
 
 void
-NotEverCrypt_CTR_init(
-  NotEverCrypt_CTR_state_s *p,
-  uint8_t *k,
-  uint8_t *iv,
-  uint32_t iv_len,
-  uint32_t c
-)
+NotEverCrypt_CTR_reset(NotEverCrypt_CTR_state_s *p, uint8_t *iv, uint32_t iv_len, uint32_t c)
 {
   NotEverCrypt_CTR_state_s scrut = *p;
+  uint8_t *block = scrut.block;
   uint8_t *ek = scrut.xkey;
   uint8_t *iv_ = scrut.iv;
   impl i = scrut.i;
   memcpy(iv_, iv, iv_len * sizeof (uint8_t));
-  switch (i)
-  {
-    case Vale_AES128:
-      {
-        #if EVERCRYPT_TARGETCONFIG_HACL_CAN_COMPILE_VALE
-        uint8_t *keys_b = ek;
-        uint8_t *hkeys_b = ek + 176U;
-        aes128_key_expansion(k, keys_b);
-        aes128_keyhash_init(keys_b, hkeys_b);
-        #endif
-        break;
-      }
-    case Vale_AES256:
-      {
-        #if EVERCRYPT_TARGETCONFIG_HACL_CAN_COMPILE_VALE
-        uint8_t *keys_b = ek;
-        uint8_t *hkeys_b = ek + 240U;
-        aes256_key_expansion(k, keys_b);
-        aes256_keyhash_init(keys_b, hkeys_b);
-        #endif
-        break;
-      }
-    case Hacl_CHACHA20:
-      {
-        memcpy(ek, k, 32U * sizeof (uint8_t));
-        break;
-      }
-    default:
-      {
-        KRML_HOST_EPRINTF("KaRaMeL incomplete match at %s:%d\n", __FILE__, __LINE__);
-        KRML_HOST_EXIT(253U);
-      }
-  }
-  *p = ((NotEverCrypt_CTR_state_s){ .i = i, .iv = iv_, .iv_len = iv_len, .xkey = ek, .ctr = c });
+  *p =
+    (
+      (NotEverCrypt_CTR_state_s){
+        .i = i,
+        .iv = iv_,
+        .iv_len = iv_len,
+        .xkey = ek,
+        .ctr = c,
+        .block = block
+      }
+    );
 }
 
 void NotEverCrypt_CTR_update_block(NotEverCrypt_CTR_state_s *p, uint8_t *dst, uint8_t *src)
@@ -529,6 +508,7 @@ void NotEverCrypt_CTR_update_block(NotEverCrypt_CTR_state_s *p, uint8_t *dst, ui
       {
         #if EVERCRYPT_TARGETCONFIG_HACL_CAN_COMPILE_VALE
         NotEverCrypt_CTR_state_s scrut = *p;
+        uint8_t *block = scrut.block;
         uint32_t c01 = scrut.ctr;
         uint8_t *ek1 = scrut.xkey;
         uint32_t iv_len1 = scrut.iv_len;
@@ -557,7 +537,8 @@ void NotEverCrypt_CTR_update_block(NotEverCrypt_CTR_state_s *p, uint8_t *dst, ui
               .iv = iv1,
               .iv_len = iv_len1,
               .xkey = ek1,
-              .ctr = c1
+              .ctr = c1,
+              .block = block
             }
           );
         #endif
@@ -567,6 +548,7 @@ void NotEverCrypt_CTR_update_block(NotEverCrypt_CTR_state_s *p, uint8_t *dst, ui
       {
         #if EVERCRYPT_TARGETCONFIG_HACL_CAN_COMPILE_VALE
         NotEverCrypt_CTR_state_s scrut = *p;
+        uint8_t *block = scrut.block;
         uint32_t c01 = scrut.ctr;
         uint8_t *ek1 = scrut.xkey;
         uint32_t iv_len1 = scrut.iv_len;
@@ -595,7 +577,8 @@ void NotEverCrypt_CTR_update_block(NotEverCrypt_CTR_state_s *p, uint8_t *dst, ui
               .iv = iv1,
               .iv_len = iv_len1,
               .xkey = ek1,
-              .ctr = c1
+              .ctr = c1,
+              .block = block
             }
           );
         #endif
@@ -616,3 +599,37 @@ void NotEverCrypt_CTR_update_block(NotEverCrypt_CTR_state_s *p, uint8_t *dst, ui
   }
 }
 
+void NotEverCrypt_CTR_free(NotEverCrypt_CTR_state_s *p)
+{
+  NotEverCrypt_CTR_state_s scrut = *p;
+  impl i = scrut.i;
+  uint8_t *block = scrut.block;
+  uint32_t ite;
+  switch (i)
+  {
+    case Vale_AES128:
+      {
+        ite = 320U;
+        break;
+      }
+    case Vale_AES256:
+      {
+        ite = 384U;
+        break;
+      }
+    case Hacl_CHACHA20:
+      {
+        ite = 44U;
+        break;
+      }
+    default:
+      {
+        KRML_HOST_EPRINTF("KaRaMeL incomplete match at %s:%d\n", __FILE__, __LINE__);
+        KRML_HOST_EXIT(253U);
+      }
+  }
+  Lib_Memzero0_memzero(block, ite, uint8_t, void *);
+  KRML_HOST_FREE(block);
+  KRML_HOST_FREE(p);
+}
+
@@ -39,19 +39,29 @@ QUIC_encrypt(
 
 EverCrypt_Error_error_code
 QUIC_decrypt(
-  EverQuic_state_s *uu___1,
-  EverQuic_result *uu___2,
-  uint8_t *uu___3,
-  uint32_t uu___4,
-  uint8_t uu___5
+  EverQuic_index i,
+  EverQuic_state_s *s,
+  EverQuic_result *dst,
+  uint8_t *packet,
+  uint32_t len,
+  uint8_t cid_len
 )
 {
-  KRML_MAYBE_UNUSED_VAR(uu___1);
-  KRML_MAYBE_UNUSED_VAR(uu___2);
-  KRML_MAYBE_UNUSED_VAR(uu___3);
-  KRML_MAYBE_UNUSED_VAR(uu___4);
-  KRML_MAYBE_UNUSED_VAR(uu___5);
-  KRML_HOST_EPRINTF("KaRaMeL abort at %s:%d\n%s\n", __FILE__, __LINE__, "");
-  KRML_HOST_EXIT(255U);
+  EverQuic_state_s *s1 = istate(i, s);
+  EverQuic_status res = EverQuic_decrypt_no_key_update(s1, dst, packet, len, cid_len);
+  switch (res)
+  {
+    case EverQuic_Ok:
+      {
+        return EverCrypt_Error_Success;
+      }
+    case EverQuic_Malformed:
+      {
+        return EverCrypt_Error_DecodeError;
+      }
+    default:
+      {
+        return EverCrypt_Error_AuthenticationFailure;
+      }
+  }
 }
-
@@ -45,11 +45,12 @@ typedef void *QUIC_decrypt_post;
 
 EverCrypt_Error_error_code
 QUIC_decrypt(
-  EverQuic_state_s *uu___1,
-  EverQuic_result *uu___2,
-  uint8_t *uu___3,
-  uint32_t uu___4,
-  uint8_t uu___5
+  EverQuic_index i,
+  EverQuic_state_s *s,
+  EverQuic_result *dst,
+  uint8_t *packet,
+  uint32_t len,
+  uint8_t cid_len
 );
 
 
@@ -16,6 +16,8 @@ extern EverQuic_index QUICTest_idx;
 
 bool QUICTest_is_success_body(EverCrypt_Error_error_code e);
 
+bool QUICTest_is_ok_body(EverQuic_status e);
+
 bool QUICTest_check_is_true_body(bool e);
 
 extern bool QUICTest_is_equal(uint8_t *b1, uint8_t *b2, uint32_t len);
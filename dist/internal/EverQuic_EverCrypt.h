@@ -45,6 +45,13 @@ Note: The caller must free the AEAD state by calling `EverCrypt_AEAD_free`.
 extern EverCrypt_Error_error_code
 EverCrypt_AEAD_create_in(Spec_Agile_AEAD_alg a, EverCrypt_AEAD_state_s **dst, uint8_t *k);
 
+/**
+Cleanup and free the AEAD state.
+
+@param s State of the AEAD algorithm.
+*/
+extern void EverCrypt_AEAD_free(EverCrypt_AEAD_state_s *s);
+
 /**
 Encrypt and authenticate a message (`plain`) with associated data (`ad`).
 
@@ -183,16 +190,12 @@ NotEverCrypt_CTR_create_in(
 );
 
 void
-NotEverCrypt_CTR_init(
-  NotEverCrypt_CTR_state_s *p,
-  uint8_t *k,
-  uint8_t *iv,
-  uint32_t iv_len,
-  uint32_t c
-);
+NotEverCrypt_CTR_reset(NotEverCrypt_CTR_state_s *p, uint8_t *iv, uint32_t iv_len, uint32_t c);
 
 void NotEverCrypt_CTR_update_block(NotEverCrypt_CTR_state_s *p, uint8_t *dst, uint8_t *src);
 
+void NotEverCrypt_CTR_free(NotEverCrypt_CTR_state_s *p);
+
 
 #define __internal_EverQuic_EverCrypt_H_DEFINED
 #endif
@@ -0,0 +1,33 @@
+/* Hand-written implementation of QUIC.Atomic (see src/QUIC.Atomic.fsti). */
+
+#ifndef __QUIC_Atomic_H
+#define __QUIC_Atomic_H
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* A relaxed fetch-and-add: callers only need distinct values, not an ordering
+   with respect to other memory accesses. */
+static inline uint64_t QUIC_Atomic_fetch_incr(uint64_t *p)
+{
+#if defined(_MSC_VER)
+  return (uint64_t)_InterlockedExchangeAdd64((volatile __int64 *)p, 1);
+#else
+  return __atomic_fetch_add(p, (uint64_t)1U, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline uint64_t QUIC_Atomic_load(uint64_t *p)
+{
+#if defined(_MSC_VER)
+  return (uint64_t)_InterlockedOr64((volatile __int64 *)p, 0);
+#else
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+#endif
+}
+
+#define __QUIC_Atomic_H_DEFINED
+#endif
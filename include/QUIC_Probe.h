@@ -0,0 +1,95 @@
+/* Hand-written implementation of QUIC.Probe (see src/QUIC.Probe.fsti). */
+
+#ifndef __QUIC_Probe_H
+#define __QUIC_Probe_H
+
+#include <stdint.h>
+
+#define QUIC_PROBE_READ_HEADER 0U
+#define QUIC_PROBE_HEADER_PROTECTION 1U
+#define QUIC_PROBE_NONCE 2U
+#define QUIC_PROBE_AEAD 3U
+#define QUIC_PROBE_STAGES 4U
+
+#if defined(EVERQUIC_PROBES)
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+typedef struct QUIC_Probe_stage_s
+{
+  uint64_t calls;
+  uint64_t cycles;
+}
+QUIC_Probe_stage;
+
+/* One set of counters per process, shared by every translation unit that
+   includes this header. Counters are updated with relaxed atomic additions, so
+   that states used through cursors from several threads do not lose counts. */
+#if defined(_MSC_VER)
+__declspec(selectany) QUIC_Probe_stage QUIC_Probe_stages[QUIC_PROBE_STAGES] = { { 0U } };
+#else
+__attribute__((weak)) QUIC_Probe_stage QUIC_Probe_stages[QUIC_PROBE_STAGES] = { { 0U } };
+#endif
+
+/* The time stamp counter where there is one, and nanoseconds otherwise. */
+static inline uint64_t QUIC_Probe_start(void)
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+  return (uint64_t)__rdtsc();
+#elif defined(__aarch64__)
+  uint64_t t;
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void QUIC_Probe_stop(uint32_t stage, uint64_t t0)
+{
+  uint64_t t1 = QUIC_Probe_start();
+  QUIC_Probe_stage *p = &QUIC_Probe_stages[stage];
+#if defined(_MSC_VER)
+  _InterlockedExchangeAdd64((volatile __int64 *)&p->calls, 1);
+  _InterlockedExchangeAdd64((volatile __int64 *)&p->cycles, (__int64)(t1 - t0));
+#else
+  __atomic_fetch_add(&p->calls, (uint64_t)1U, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&p->cycles, t1 - t0, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void QUIC_Probe_reset(void)
+{
+  for (uint32_t i = 0U; i < QUIC_PROBE_STAGES; i++)
+  {
+    QUIC_Probe_stages[i].calls = 0U;
+    QUIC_Probe_stages[i].cycles = 0U;
+  }
+}
+
+#else
+
+/* Probes are disabled: the calls in the extracted code compile to nothing. */
+static inline uint64_t QUIC_Probe_start(void)
+{
+  return 0U;
+}
+
+static inline void QUIC_Probe_stop(uint32_t stage, uint64_t t0)
+{
+  (void)stage;
+  (void)t0;
+}
+
+#endif
+
+#define __QUIC_Probe_H_DEFINED
+#endif
@@ -0,0 +1,495 @@
+/* Benchmarks for the EverQuic packet protection API.
+ *
+ * The main matrix measures EverQuic_encrypt and EverQuic_decrypt for every
+ * AEAD, both header forms (1-RTT short headers and Handshake long headers),
+ * packet number lengths 1 to 4 and payloads of 16 to 1500 bytes. With a small
+ * payload, the fixed per-packet cost (header protection, nonce derivation,
+ * AEAD setup) dominates over the bulk AEAD cost; cycles/B is per payload byte.
+ * Short-header packets with a 1-byte packet number are also measured with the
+ * batched API, and with a replay window on fresh packets and on duplicates,
+ * which are rejected before the AEAD runs. The cost of setting up and tearing
+ * down a state (key derivation, key expansion, allocations) is measured
+ * separately, as are the Initial secrets and the cost of obtaining the Initial
+ * states of a connection with and without the Initial cache.
+ *
+ * Usage: bench.exe [results.csv]. The optional argument receives one CSV row
+ * per measurement, for comparison between builds. When the library and this
+ * file are compiled with -DEVERQUIC_PROBES, each row also breaks the cycles
+ * per operation down into the stages instrumented by include/QUIC_Probe.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#define HAS_RDTSC 1
+#endif
+
+#include "EverQuic.h"
+#include "QUIC_Probe.h"
+
+extern void EverCrypt_AutoConfig2_init(void);
+
+#define ROUNDS 200000U
+#define MATRIX_ROUNDS 20000U
+#define CID_LEN 8U
+#define MAX_PLAIN_LEN 1500U
+#define MAX_PACKET_LEN (MAX_PLAIN_LEN + 64U)
+#define BATCH 32U
+#define SETUP_ROUNDS 20000U
+#define WINDOW_BITS 1024U
+#define TRAIN 1024U
+#define SEGMENTS 4U
+
+static uint8_t traffic_secret[32U] = {
+  0x48U, 0xc4U, 0x30U, 0x9bU, 0x5fU, 0x27U, 0x52U, 0xe8U, 0x12U, 0x7bU, 0x01U, 0x66U, 0x05U, 0x5aU,
+  0x9aU, 0x56U, 0xe5U, 0xf9U, 0x06U, 0x31U, 0xe0U, 0x84U, 0x85U, 0xe0U, 0xf8U, 0x9eU, 0x9cU,
+  0xecU, 0x4aU, 0xdeU, 0xb6U, 0x50U
+};
+
+static FILE *csv = NULL;
+
+static const char *stage_names[QUIC_PROBE_STAGES] = { "read_header", "hp", "nonce", "aead" };
+
+/* Wall-clock and cycle counters, and the cycles accumulated by each probe so
+   far (zero when probes are disabled). Measurements are differences of two
+   such readings, so that probes never need to be reset. */
+typedef struct {
+  uint64_t ns;
+  uint64_t cycles;
+  uint64_t stages[QUIC_PROBE_STAGES];
+} bench_time;
+
+static bench_time now(void) {
+  struct timespec ts;
+  bench_time t;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  t.ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#ifdef HAS_RDTSC
+  t.cycles = __rdtsc();
+#else
+  t.cycles = 0;
+#endif
+  for (uint32_t k = 0U; k < QUIC_PROBE_STAGES; k++) {
+#ifdef EVERQUIC_PROBES
+    t.stages[k] = __atomic_load_n(&QUIC_Probe_stages[k].cycles, __ATOMIC_RELAXED);
+#else
+    t.stages[k] = 0U;
+#endif
+  }
+  return t;
+}
+
+/* Adds t1 - t0 to acc. */
+static void accumulate(bench_time *acc, bench_time t0, bench_time t1) {
+  acc->ns += t1.ns - t0.ns;
+  acc->cycles += t1.cycles - t0.cycles;
+  for (uint32_t k = 0U; k < QUIC_PROBE_STAGES; k++)
+    acc->stages[k] += t1.stages[k] - t0.stages[k];
+}
+
+/* One measurement of n operations. form, pn_len and plain_len describe the
+   packets, and are empty, 0 and 0 for operations on states. */
+static void report(const char *alg, const char *op, const char *form, uint32_t pn_len,
+  uint32_t plain_len, uint32_t n, bench_time t0, bench_time t1) {
+  double ns = (double)(t1.ns - t0.ns);
+  double cycles = (double)(t1.cycles - t0.cycles);
+  double per_byte = plain_len == 0U ? 0.0 : cycles / n / plain_len;
+  char shape[32] = "";
+  char bytes[32] = "";
+  if (plain_len != 0U) {
+    snprintf(shape, sizeof shape, "%s pn%u %u B", form, pn_len, plain_len);
+    snprintf(bytes, sizeof bytes, "%.2f cycles/B", per_byte);
+  }
+  printf("%-18s %-8s %-17s  %9.1f ns/op  %9.1f cycles/op  %15s  %10.0f op/s",
+    alg, op, shape, ns / n, cycles / n, bytes, n * 1e9 / ns);
+#ifdef EVERQUIC_PROBES
+  for (uint32_t k = 0U; k < QUIC_PROBE_STAGES; k++)
+    printf("  %s %.1f", stage_names[k], (double)(t1.stages[k] - t0.stages[k]) / n);
+#endif
+  printf("\n");
+  if (csv != NULL) {
+    fprintf(csv, "%s,%s,%s,%u,%u,%u,%.1f,%.1f,%.0f,%.3f", alg, op, form, pn_len, plain_len, n,
+      ns / n, cycles / n, n * 1e9 / ns, per_byte);
+    for (uint32_t k = 0U; k < QUIC_PROBE_STAGES; k++) {
+#ifdef EVERQUIC_PROBES
+      fprintf(csv, ",%.1f", (double)(t1.stages[k] - t0.stages[k]) / n);
+#else
+      fprintf(csv, ",");
+#endif
+    }
+    fprintf(csv, "\n");
+  }
+}
+
+static void report_header(void) {
+  if (csv == NULL)
+    return;
+  fprintf(csv, "alg,op,form,pn_len,plain_len,n,ns_per_op,cycles_per_op,op_per_s,cycles_per_byte");
+  for (uint32_t k = 0U; k < QUIC_PROBE_STAGES; k++)
+    fprintf(csv, ",%s_cycles_per_op", stage_names[k]);
+  fprintf(csv, "\n");
+}
+
+static EverQuic_header short_header(uint8_t *cid, uint32_t pn_len) {
+  EverQuic_header h;
+  h.tag = EverQuic_BShort;
+  h.case_BShort.reserved_bits = 0U;
+  h.case_BShort.spin = false;
+  h.case_BShort.phase = 0U;
+  h.case_BShort.cid = cid;
+  h.case_BShort.cid_len = CID_LEN;
+  h.case_BShort.packet_number_length = pn_len;
+  return h;
+}
+
+static EverQuic_header handshake_header(uint8_t *cid, uint32_t pn_len, uint32_t plain_len) {
+  EverQuic_header h;
+  h.tag = EverQuic_BLong;
+  h.case_BLong.version = 1U;
+  h.case_BLong.dcid = cid;
+  h.case_BLong.dcil = CID_LEN;
+  h.case_BLong.scid = cid;
+  h.case_BLong.scil = CID_LEN;
+  h.case_BLong.spec.tag = EverQuic_BHandshake;
+  h.case_BLong.spec.case_BHandshake.reserved_bits = 0U;
+  h.case_BLong.spec.case_BHandshake.payload_and_pn_length = (uint64_t)(pn_len + plain_len + 16U);
+  h.case_BLong.spec.case_BHandshake.packet_number_length = pn_len;
+  return h;
+}
+
+/* MATRIX_ROUNDS packets of one shape through EverQuic_encrypt and
+   EverQuic_decrypt. */
+static int bench_packet(const char *name, Spec_Agile_AEAD_alg a, bool is_short, uint32_t pn_len,
+  uint32_t plain_len) {
+  EverQuic_index i = { .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = a };
+  EverQuic_state_s *st_enc = NULL;
+  EverQuic_state_s *st_dec = NULL;
+  uint8_t cid[CID_LEN] = { 0U };
+  uint8_t plain[MAX_PLAIN_LEN] = { 0U };
+  uint8_t packet[MAX_PACKET_LEN];
+  uint8_t scratch[MAX_PACKET_LEN];
+  const char *form = is_short ? "short" : "long";
+  EverQuic_header h = is_short ? short_header(cid, pn_len) : handshake_header(cid, pn_len, plain_len);
+  EverQuic_result r;
+  uint64_t pn;
+  uint32_t len = EverQuic_header_len(h) + plain_len + 16U;
+
+  if (EverQuic_create_in(i, &st_enc, 0ULL, traffic_secret) != EverCrypt_Error_Success) {
+    printf("%-18s unsupported on this platform, skipping\n", name);
+    return 0;
+  }
+
+  bench_time t0 = now();
+  for (uint32_t j = 0U; j < MATRIX_ROUNDS; j++)
+    if (EverQuic_encrypt(st_enc, packet, &pn, h, plain, plain_len) != EverCrypt_Error_Success)
+      return 1;
+  bench_time t1 = now();
+  report(name, "encrypt", form, pn_len, plain_len, MATRIX_ROUNDS, t0, t1);
+
+  /* Decryption is in-place, so each round works on a fresh copy of the last
+     packet; the copy is included in the timing. The receiver starts right
+     before the last packet number, so that short packet numbers expand
+     correctly. */
+  if (EverQuic_create_in(i, &st_dec, pn - 1U, traffic_secret) != EverCrypt_Error_Success)
+    return 1;
+  t0 = now();
+  for (uint32_t j = 0U; j < MATRIX_ROUNDS; j++) {
+    memcpy(scratch, packet, len);
+    if (EverQuic_decrypt(st_dec, &r, scratch, len, (uint8_t)CID_LEN) != EverQuic_Ok)
+      return 1;
+  }
+  t1 = now();
+  report(name, "decrypt", form, pn_len, plain_len, MATRIX_ROUNDS, t0, t1);
+
+  int ret = r.pn != pn || r.plain_len != plain_len || memcmp(scratch + r.header_len, plain, plain_len) != 0;
+  EverQuic_free(st_enc);
+  EverQuic_free(st_dec);
+  return ret;
+}
+
+/* Trains of BATCH packets going through EverQuic_encrypt_batch and
+   EverQuic_decrypt_batch. */
+static int bench_alg_batch(const char *name, Spec_Agile_AEAD_alg a, uint32_t plain_len) {
+  static uint8_t packets[BATCH][MAX_PACKET_LEN];
+  static uint8_t scratch[BATCH][MAX_PACKET_LEN];
+  EverQuic_index i = { .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = a };
+  EverQuic_state_s *st_enc = NULL;
+  EverQuic_state_s *st_dec = NULL;
+  uint8_t cid[CID_LEN] = { 0U };
+  uint8_t plain[MAX_PLAIN_LEN] = { 0U };
+  EverQuic_encrypt_desc eds[BATCH];
+  EverQuic_decrypt_desc dds[BATCH];
+  EverQuic_header h = short_header(cid, 1U);
+  uint32_t len = EverQuic_header_len(h) + plain_len + 16U;
+
+  if (EverQuic_create_in(i, &st_enc, 0ULL, traffic_secret) != EverCrypt_Error_Success)
+    return 0;
+  for (uint32_t k = 0U; k < BATCH; k++) {
+    eds[k].dst = packets[k];
+    eds[k].hdr = h;
+    eds[k].plain = plain;
+    eds[k].plain_length = plain_len;
+  }
+
+  bench_time t0 = now();
+  for (uint32_t j = 0U; j < ROUNDS / BATCH; j++)
+    EverQuic_encrypt_batch(st_enc, eds, BATCH);
+  bench_time t1 = now();
+  report(name, "enc-x32", "short", 1U, plain_len, ROUNDS / BATCH * BATCH, t0, t1);
+
+  if (EverQuic_create_in(i, &st_dec, eds[0].assigned_pn - 1U, traffic_secret) != EverCrypt_Error_Success)
+    return 1;
+  t0 = now();
+  for (uint32_t j = 0U; j < ROUNDS / BATCH; j++) {
+    for (uint32_t k = 0U; k < BATCH; k++) {
+      memcpy(scratch[k], packets[k], len);
+      dds[k].packet = scratch[k];
+      dds[k].packet_len = len;
+    }
+    EverQuic_decrypt_batch(st_dec, dds, BATCH, (uint8_t)CID_LEN);
+  }
+  t1 = now();
+  report(name, "dec-x32", "short", 1U, plain_len, ROUNDS / BATCH * BATCH, t0, t1);
+
+  int ret = 0;
+  for (uint32_t k = 0U; k < BATCH; k++)
+    ret |= eds[k].err != EverCrypt_Error_Success || dds[k].err != EverQuic_Ok ||
+      dds[k].res.pn != eds[k].assigned_pn;
+  EverQuic_free(st_enc);
+  EverQuic_free(st_dec);
+  return ret;
+}
+
+/* A receiver created with a WINDOW_BITS replay window. Fresh packets are
+   encrypted in trains of TRAIN packets outside of the timed sections. The
+   duplicates replay the last packet of the last train: compare with the
+   decrypt rows, where the receiver has no window and accepts the duplicate. */
+static int bench_alg_replay(const char *name, Spec_Agile_AEAD_alg a, uint32_t plain_len) {
+  static uint8_t packets[TRAIN][MAX_PACKET_LEN];
+  EverQuic_index i = { .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = a };
+  EverQuic_state_s *st_enc = NULL;
+  EverQuic_state_s *st_dec = NULL;
+  uint8_t cid[CID_LEN] = { 0U };
+  uint8_t plain[MAX_PLAIN_LEN] = { 0U };
+  uint8_t scratch[MAX_PACKET_LEN];
+  EverQuic_header h = short_header(cid, 1U);
+  EverQuic_result r;
+  uint64_t pn;
+  uint32_t len = EverQuic_header_len(h) + plain_len + 16U;
+  bench_time zero = { 0U };
+  bench_time fresh = { 0U };
+
+  if (EverQuic_create_in(i, &st_enc, 0ULL, traffic_secret) != EverCrypt_Error_Success)
+    return 0;
+  if (EverQuic_create_in_with_replay_window(i, &st_dec, 0ULL, traffic_secret, WINDOW_BITS)
+    != EverQuic_Ok)
+    return 1;
+  for (uint32_t j = 0U; j < ROUNDS / TRAIN; j++) {
+    for (uint32_t k = 0U; k < TRAIN; k++)
+      if (EverQuic_encrypt(st_enc, packets[k], &pn, h, plain, plain_len) != EverCrypt_Error_Success)
+        return 1;
+    bench_time t0 = now();
+    for (uint32_t k = 0U; k < TRAIN; k++) {
+      memcpy(scratch, packets[k], len);
+      if (EverQuic_decrypt(st_dec, &r, scratch, len, (uint8_t)CID_LEN) != EverQuic_Ok)
+        return 1;
+    }
+    accumulate(&fresh, t0, now());
+  }
+  report(name, "dec-win", "short", 1U, plain_len, ROUNDS / TRAIN * TRAIN, zero, fresh);
+
+  bench_time t0 = now();
+  for (uint32_t j = 0U; j < ROUNDS; j++) {
+    memcpy(scratch, packets[TRAIN - 1U], len);
+    if (EverQuic_decrypt(st_dec, &r, scratch, len, (uint8_t)CID_LEN) != EverQuic_Replayed)
+      return 1;
+  }
+  bench_time t1 = now();
+  report(name, "replay", "short", 1U, plain_len, ROUNDS, t0, t1);
+
+  int ret = r.pn != pn || EverQuic_last_packet_number_of_state(st_dec) != pn;
+  EverQuic_free(st_enc);
+  EverQuic_free(st_dec);
+  return ret;
+}
+
+/* A plaintext in SEGMENTS pieces, as assembled by a caller from its frames:
+   copied into a staging buffer for EverQuic_encrypt, or passed as is to
+   EverQuic_encrypt_gather, which copies them into the packet instead. Both
+   copy the plaintext once. */
+static int bench_alg_gather(const char *name, Spec_Agile_AEAD_alg a, uint32_t plain_len) {
+  EverQuic_index i = { .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = a };
+  EverQuic_state_s *st_copy = NULL;
+  EverQuic_state_s *st_iov = NULL;
+  uint8_t cid[CID_LEN] = { 0U };
+  uint8_t frames[SEGMENTS][MAX_PLAIN_LEN] = { { 0U } };
+  uint8_t staging[MAX_PLAIN_LEN];
+  uint8_t packet[MAX_PACKET_LEN];
+  uint8_t packet_iov[MAX_PACKET_LEN];
+  EverQuic_iovec iov[SEGMENTS];
+  EverQuic_header h = short_header(cid, 1U);
+  uint32_t len = EverQuic_header_len(h) + plain_len + 16U;
+  uint64_t pn;
+
+  for (uint32_t k = 0U; k < SEGMENTS; k++) {
+    iov[k].iov_base = frames[k];
+    iov[k].iov_len = plain_len / SEGMENTS + (k < plain_len % SEGMENTS ? 1U : 0U);
+    memset(frames[k], (int)k, iov[k].iov_len);
+  }
+  if (EverQuic_create_in(i, &st_copy, 0ULL, traffic_secret) != EverCrypt_Error_Success)
+    return 0;
+  if (EverQuic_create_in(i, &st_iov, 0ULL, traffic_secret) != EverCrypt_Error_Success)
+    return 1;
+
+  bench_time t0 = now();
+  for (uint32_t j = 0U; j < ROUNDS; j++) {
+    uint32_t off = 0U;
+    for (uint32_t k = 0U; k < SEGMENTS; k++) {
+      memcpy(staging + off, iov[k].iov_base, iov[k].iov_len);
+      off += iov[k].iov_len;
+    }
+    if (EverQuic_encrypt(st_copy, packet, &pn, h, staging, plain_len) != EverCrypt_Error_Success)
+      return 1;
+  }
+  bench_time t1 = now();
+  report(name, "enc-copy", "short", 1U, plain_len, ROUNDS, t0, t1);
+
+  t0 = now();
+  for (uint32_t j = 0U; j < ROUNDS; j++)
+    if (EverQuic_encrypt_gather(st_iov, packet_iov, &pn, h, iov, SEGMENTS) != EverCrypt_Error_Success)
+      return 1;
+  t1 = now();
+  report(name, "enc-iov", "short", 1U, plain_len, ROUNDS, t0, t1);
+
+  int ret = memcmp(packet, packet_iov, len) != 0;
+  EverQuic_free(st_copy);
+  EverQuic_free(st_iov);
+  return ret;
+}
+
+/* EverQuic_create_in followed by EverQuic_free, as done for each epoch and
+   direction of every connection. */
+static int bench_setup(const char *name, Spec_Agile_AEAD_alg a) {
+  EverQuic_index i = { .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = a };
+  EverQuic_state_s *st = NULL;
+
+  bench_time t0 = now();
+  for (uint32_t j = 0U; j < SETUP_ROUNDS; j++) {
+    if (EverQuic_create_in(i, &st, 0ULL, traffic_secret) != EverCrypt_Error_Success) {
+      printf("%-18s unsupported on this platform, skipping\n", name);
+      return 0;
+    }
+    EverQuic_free(st);
+  }
+  bench_time t1 = now();
+  report(name, "setup", "", 0U, 0U, SETUP_ROUNDS, t0, t1);
+  return 0;
+}
+
+/* The Initial secrets for a Destination Connection ID; then the Initial states,
+   created from scratch with the secrets and two EverQuic_create_in, then with
+   EverQuic_create_initial_in, then looked up in an Initial cache that already
+   holds them, as for a repeated Initial packet. */
+static int bench_initial(void) {
+  uint8_t cid[CID_LEN] = { 0x83U, 0x94U, 0xc8U, 0xf0U, 0x3eU, 0x51U, 0x57U, 0x08U };
+  uint8_t client_secret[32U];
+  uint8_t server_secret[32U];
+  EverQuic_state_s *client = NULL;
+  EverQuic_state_s *server = NULL;
+
+  bench_time t0 = now();
+  for (uint32_t j = 0U; j < SETUP_ROUNDS; j++)
+    EverQuic_initial_secrets(client_secret, server_secret, cid, CID_LEN);
+  bench_time t1 = now();
+  report("Initial", "secrets", "", 0U, 0U, SETUP_ROUNDS, t0, t1);
+
+  EverQuic_index i = { .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = Spec_Agile_AEAD_AES128_GCM };
+  t0 = now();
+  for (uint32_t j = 0U; j < SETUP_ROUNDS; j++) {
+    EverQuic_initial_secrets(client_secret, server_secret, cid, CID_LEN);
+    if (EverQuic_create_in(i, &client, 0ULL, client_secret) != EverCrypt_Error_Success ||
+        EverQuic_create_in(i, &server, 0ULL, server_secret) != EverCrypt_Error_Success) {
+      if (client != NULL)
+        EverQuic_free(client);
+      printf("%-18s unsupported on this platform, skipping\n", "Initial");
+      return 0;
+    }
+    EverQuic_free(client);
+    EverQuic_free(server);
+    client = NULL;
+  }
+  t1 = now();
+  report("Initial", "separate", "", 0U, 0U, SETUP_ROUNDS, t0, t1);
+
+  t0 = now();
+  for (uint32_t j = 0U; j < SETUP_ROUNDS; j++) {
+    if (EverQuic_create_initial_in(&client, &server, cid, CID_LEN) != EverCrypt_Error_Success) {
+      printf("%-18s unsupported on this platform, skipping\n", "Initial");
+      return 0;
+    }
+    EverQuic_free(client);
+    EverQuic_free(server);
+  }
+  t1 = now();
+  report("Initial", "create", "", 0U, 0U, SETUP_ROUNDS, t0, t1);
+
+  EverQuic_initial_cache_s *c = EverQuic_initial_cache_create_in(256U, 0x9e3779b9U);
+  bool created;
+  if (EverQuic_initial_cache_find(c, cid, CID_LEN, &client, &server, &created) != EverCrypt_Error_Success)
+    return 1;
+  t0 = now();
+  for (uint32_t j = 0U; j < ROUNDS; j++)
+    if (EverQuic_initial_cache_find(c, cid, CID_LEN, &client, &server, &created) != EverCrypt_Error_Success)
+      return 1;
+  t1 = now();
+  report("Initial", "cached", "", 0U, 0U, ROUNDS, t0, t1);
+  int ret = EverQuic_initial_cache_hits(c) != ROUNDS || EverQuic_initial_cache_misses(c) != 1U;
+  EverQuic_initial_cache_free(c);
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  static const struct {
+    const char *name;
+    Spec_Agile_AEAD_alg alg;
+  } algs[] = {
+    { "AES128-GCM", Spec_Agile_AEAD_AES128_GCM },
+    { "AES256-GCM", Spec_Agile_AEAD_AES256_GCM },
+    { "CHACHA20-POLY1305", Spec_Agile_AEAD_CHACHA20_POLY1305 }
+  };
+  static const uint32_t plain_lens[] = { 16U, 64U, 256U, 512U, 1024U, 1200U, 1500U };
+  static const uint32_t batch_plain_lens[] = { 16U, 1200U };
+  int ret = 0;
+
+  if (argc > 1) {
+    csv = fopen(argv[1], "w");
+    if (csv == NULL) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+  report_header();
+
+  EverCrypt_AutoConfig2_init();
+  for (size_t a = 0; a < sizeof algs / sizeof algs[0]; a++)
+    ret |= bench_setup(algs[a].name, algs[a].alg);
+  ret |= bench_initial();
+  for (size_t a = 0; a < sizeof algs / sizeof algs[0]; a++)
+    for (int is_short = 1; is_short >= 0; is_short--)
+      for (uint32_t pn_len = 1U; pn_len <= 4U; pn_len++)
+        for (size_t k = 0; k < sizeof plain_lens / sizeof plain_lens[0]; k++)
+          ret |= bench_packet(algs[a].name, algs[a].alg, is_short, pn_len, plain_lens[k]);
+  for (size_t k = 0; k < sizeof batch_plain_lens / sizeof batch_plain_lens[0]; k++)
+    for (size_t a = 0; a < sizeof algs / sizeof algs[0]; a++) {
+      ret |= bench_alg_batch(algs[a].name, algs[a].alg, batch_plain_lens[k]);
+      ret |= bench_alg_replay(algs[a].name, algs[a].alg, batch_plain_lens[k]);
+      ret |= bench_alg_gather(algs[a].name, algs[a].alg, batch_plain_lens[k]);
+    }
+  if (csv != NULL)
+    fclose(csv);
+  if (ret)
+    printf("round-trip check failed\n");
+  return ret;
+}
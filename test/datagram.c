@@ -0,0 +1,302 @@
+/* Tests for EverQuic_decrypt_datagram.
+ *
+ * A datagram coalescing an Initial, a Handshake and a 1-RTT packet is built
+ * with QUIC_encrypt and EverQuic_encrypt, then taken apart with
+ * EverQuic_decrypt_datagram, whose results are checked against QUIC_decrypt
+ * on each packet in isolation. The keys of each epoch are then removed in
+ * turn: a long header packet without keys must be skipped using its Length
+ * field, with the packets after it still decrypted, while a short header
+ * packet without keys takes up the rest of the datagram. Finally, the middle
+ * packet fails to authenticate, then is replayed: the packets after it must
+ * still be decrypted. */
+
+#define TEST_NAME "datagram"
+#include "test.h"
+
+#include "QUIC.h"
+
+#define PN_LEN 2U
+#define PACKETS 3U
+#define MAX_DATAGRAM_LEN 1500U
+
+/* One secret per epoch, as long as the longest hash; they only need to
+   differ. */
+static uint8_t secrets[PACKETS][48U];
+
+static const uint32_t plain_lens[PACKETS] = { 40U, 30U, 50U };
+
+/* The packet numbers assigned by the senders. */
+static uint64_t pns[PACKETS];
+
+static EverQuic_index indices[PACKETS] = {
+  { .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = Spec_Agile_AEAD_AES128_GCM },
+  { .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = Spec_Agile_AEAD_CHACHA20_POLY1305 },
+  { .hash_alg = Spec_Hash_Definitions_SHA2_384, .aead_alg = Spec_Agile_AEAD_AES256_GCM }
+};
+
+static EverQuic_header long_header(uint8_t ty, uint32_t plain_len)
+{
+  EverQuic_header h;
+  memset(&h, 0, sizeof h);
+  h.tag = EverQuic_BLong;
+  h.case_BLong.version = 1U;
+  h.case_BLong.dcid = cid;
+  h.case_BLong.dcil = CID_LEN;
+  h.case_BLong.scid = cid;
+  h.case_BLong.scil = CID_LEN;
+  h.case_BLong.spec.tag = ty;
+  if (ty == EverQuic_BInitial) {
+    h.case_BLong.spec.case_BInitial.payload_and_pn_length = PN_LEN + plain_len + 16U;
+    h.case_BLong.spec.case_BInitial.packet_number_length = PN_LEN;
+  } else {
+    h.case_BLong.spec.case_BHandshake.payload_and_pn_length = PN_LEN + plain_len + 16U;
+    h.case_BLong.spec.case_BHandshake.packet_number_length = PN_LEN;
+  }
+  return h;
+}
+
+static EverQuic_header header_of(uint32_t k)
+{
+  if (k == 0U)
+    return long_header(EverQuic_BInitial, plain_lens[k]);
+  else if (k == 1U)
+    return long_header(EverQuic_BHandshake, plain_lens[k]);
+  else
+    return short_header(0U, PN_LEN);
+}
+
+static void free_states(EverQuic_state_s **states)
+{
+  for (uint32_t k = 0U; k < PACKETS; k++)
+    free_state(&states[k]);
+}
+
+static int create_states(EverQuic_state_s **states)
+{
+  for (uint32_t k = 0U; k < PACKETS; k++)
+    states[k] = NULL;
+  for (uint32_t k = 0U; k < PACKETS; k++)
+    CHECK(EverQuic_create_in(indices[k], &states[k], 0U, secrets[k]) == EverCrypt_Error_Success);
+  return 0;
+
+fail:
+  free_states(states);
+  return 1;
+}
+
+/* Decrypts the datagram with the Initial, Handshake and 1-RTT states, any of
+   which may be null, and checks the descriptors against the expected offsets
+   and lengths of the packets, and against QUIC_decrypt. */
+static int check_datagram(uint8_t *datagram, uint32_t len, uint32_t *offsets, uint32_t *lens,
+  uint8_t **plains, bool *has_keys)
+{
+  uint8_t copy[MAX_DATAGRAM_LEN];
+  memcpy(copy, datagram, len);
+
+  EverQuic_state_s *states[PACKETS];
+  EverQuic_state_s *q = NULL;
+  if (create_states(states))
+    return 1;
+  for (uint32_t k = 0U; k < PACKETS; k++)
+    if (!has_keys[k])
+      free_state(&states[k]);
+  EverQuic_epoch_states ss = {
+    .initial = states[0U], .zero_rtt = NULL, .handshake = states[1U], .one_rtt = states[2U]
+  };
+  EverQuic_decrypt_desc descs[PACKETS + 1U];
+  memset(descs, 0, sizeof descs);
+  uint32_t count = EverQuic_decrypt_datagram(ss, descs, PACKETS + 1U, datagram, len, CID_LEN);
+
+  /* A short header packet without keys takes up the rest of the datagram,
+     which here is the same as its own length. */
+  CHECK(count == PACKETS);
+  for (uint32_t k = 0U; k < count; k++) {
+    EverQuic_decrypt_desc d = descs[k];
+    CHECK(d.packet == datagram + offsets[k]);
+    CHECK(d.packet_len == lens[k]);
+    if (!has_keys[k]) {
+      CHECK(d.err == EverQuic_NoKeys);
+      CHECK(memcmp(d.packet, copy + offsets[k], lens[k]) == 0);
+      continue;
+    }
+    CHECK(d.err == EverQuic_Ok);
+    CHECK(d.res.pn == pns[k]);
+    CHECK(d.res.total_len == lens[k]);
+    CHECK(d.res.plain_len == plain_lens[k]);
+    CHECK(memcmp(d.packet + d.res.header_len, plains[k], plain_lens[k]) == 0);
+
+    /* The same packet, on its own, through the QUIC API, with a fresh state:
+       for long headers the rest of the datagram follows the packet. */
+    CHECK(EverQuic_create_in(indices[k], &q, 0U, secrets[k]) == EverCrypt_Error_Success);
+    uint8_t packet[MAX_DATAGRAM_LEN];
+    uint32_t packet_len = len - offsets[k];
+    memcpy(packet, copy + offsets[k], packet_len);
+    EverQuic_result r;
+    EverCrypt_Error_error_code err = QUIC_decrypt(indices[k], q, &r, packet, packet_len, CID_LEN);
+    free_state(&q);
+    CHECK(err == EverCrypt_Error_Success);
+    CHECK(r.pn == d.res.pn);
+    CHECK(r.header_len == d.res.header_len);
+    CHECK(r.total_len == d.res.total_len);
+    CHECK(r.plain_len == d.res.plain_len);
+    CHECK(memcmp(packet + r.header_len, d.packet + d.res.header_len, r.plain_len) == 0);
+  }
+
+  free_states(states);
+  return 0;
+
+fail:
+  free_state(&q);
+  free_states(states);
+  return 1;
+}
+
+/* Checks that the packets around the middle (Handshake) one, which must fail
+   with err, are still decrypted, and that the middle one is skipped using
+   its Length field. */
+static int check_around(EverQuic_decrypt_desc *descs, uint32_t count, uint8_t *datagram,
+  uint32_t *offsets, uint32_t *lens, uint8_t **plains, EverQuic_status err)
+{
+  CHECK(count == PACKETS);
+  CHECK(descs[1U].err == err);
+  CHECK(descs[1U].packet == datagram + offsets[1U]);
+  CHECK(descs[1U].packet_len == lens[1U]);
+  for (uint32_t k = 0U; k < PACKETS; k += 2U) {
+    EverQuic_decrypt_desc d = descs[k];
+    CHECK(d.err == EverQuic_Ok);
+    CHECK(d.packet == datagram + offsets[k]);
+    CHECK(d.packet_len == lens[k]);
+    CHECK(d.res.pn == pns[k]);
+    CHECK(memcmp(d.packet + d.res.header_len, plains[k], plain_lens[k]) == 0);
+  }
+  return 0;
+
+fail:
+  return 1;
+}
+
+/* A middle packet that fails to authenticate, then one that is replayed, does
+   not stop the packets after it from being decrypted. The replay is detected
+   by a Handshake state with a replay window that sees the datagram twice. */
+static int middle_failures(uint8_t *datagram, uint8_t *copy, uint32_t len, uint32_t *offsets,
+  uint32_t *lens, uint8_t **plains)
+{
+  EverQuic_state_s *states[PACKETS] = { NULL };
+  EverQuic_state_s *windowed = NULL;
+  EverQuic_decrypt_desc descs[PACKETS + 1U];
+  uint32_t count;
+
+  CHECK(create_states(states) == 0);
+  EverQuic_epoch_states ss = {
+    .initial = states[0U], .zero_rtt = NULL, .handshake = states[1U], .one_rtt = states[2U]
+  };
+  memcpy(datagram, copy, len);
+  datagram[offsets[1U] + lens[1U] - 1U] ^= 1U;
+  count = EverQuic_decrypt_datagram(ss, descs, PACKETS + 1U, datagram, len, CID_LEN);
+  if (check_around(descs, count, datagram, offsets, lens, plains, EverQuic_Unauthenticated))
+    goto fail;
+  free_states(states);
+
+  CHECK(EverQuic_create_in_with_replay_window(indices[1U], &windowed, 0U, secrets[1U], 128U) ==
+    EverQuic_Ok);
+  for (uint32_t round = 0U; round < 2U; round++) {
+    CHECK(create_states(states) == 0);
+    ss.initial = states[0U];
+    ss.handshake = windowed;
+    ss.one_rtt = states[2U];
+    memcpy(datagram, copy, len);
+    count = EverQuic_decrypt_datagram(ss, descs, PACKETS + 1U, datagram, len, CID_LEN);
+    if (check_around(descs, count, datagram, offsets, lens, plains,
+        round == 0U ? EverQuic_Ok : EverQuic_Replayed))
+      goto fail;
+    free_states(states);
+  }
+  free_state(&windowed);
+  return 0;
+
+fail:
+  free_state(&windowed);
+  free_states(states);
+  return 1;
+}
+
+int datagram_test(void)
+{
+  EverCrypt_AutoConfig2_init();
+  for (uint32_t k = 0U; k < PACKETS; k++)
+    for (uint32_t j = 0U; j < 48U; j++)
+      secrets[k][j] = (uint8_t)(0x10U * k + j);
+
+  uint8_t *plains[PACKETS];
+  for (uint32_t k = 0U; k < PACKETS; k++) {
+    plains[k] = malloc(plain_lens[k]);
+    for (uint32_t j = 0U; j < plain_lens[k]; j++)
+      plains[k][j] = (uint8_t)(k + j);
+  }
+
+  EverQuic_state_s *states[PACKETS] = { NULL };
+  CHECK(create_states(states) == 0);
+  uint8_t datagram[MAX_DATAGRAM_LEN];
+  uint32_t offsets[PACKETS], lens[PACKETS];
+  uint32_t len = 0U;
+  for (uint32_t k = 0U; k < PACKETS; k++) {
+    EverQuic_header h = header_of(k);
+    EverCrypt_Error_error_code err;
+    /* The Initial packet goes through the QUIC API, the others through
+       EverQuic directly. */
+    if (k == 0U)
+      err = QUIC_encrypt(indices[k], states[k], datagram + len, &pns[k], h, plains[k], plain_lens[k]);
+    else
+      err = EverQuic_encrypt(states[k], datagram + len, &pns[k], h, plains[k], plain_lens[k]);
+    CHECK(err == EverCrypt_Error_Success);
+    offsets[k] = len;
+    lens[k] = EverQuic_header_len(h) + plain_lens[k] + 16U;
+    len += lens[k];
+  }
+  free_states(states);
+
+  uint8_t copy[MAX_DATAGRAM_LEN];
+  memcpy(copy, datagram, len);
+  /* All keys, then each epoch in turn without its keys. */
+  for (uint32_t missing = 0U; missing <= PACKETS; missing++) {
+    bool has_keys[PACKETS];
+    for (uint32_t k = 0U; k < PACKETS; k++)
+      has_keys[k] = k != missing;
+    memcpy(datagram, copy, len);
+    if (check_datagram(datagram, len, offsets, lens, plains, has_keys))
+      goto fail;
+  }
+
+  /* Without 1-RTT keys, the short header packet takes up the rest of the
+     datagram, including any trailing bytes. */
+  {
+    CHECK(create_states(states) == 0);
+    free_state(&states[2U]);
+    EverQuic_epoch_states ss = {
+      .initial = states[0U], .zero_rtt = NULL, .handshake = states[1U], .one_rtt = NULL
+    };
+    memcpy(datagram, copy, len);
+    memset(datagram + len, 0, 20U);
+    EverQuic_decrypt_desc descs[PACKETS + 1U];
+    uint32_t count = EverQuic_decrypt_datagram(ss, descs, PACKETS + 1U, datagram, len + 20U, CID_LEN);
+    CHECK(count == PACKETS);
+    CHECK(descs[2U].err == EverQuic_NoKeys);
+    CHECK(descs[2U].packet == datagram + offsets[2U]);
+    CHECK(descs[2U].packet_len == lens[2U] + 20U);
+    free_states(states);
+  }
+
+  if (middle_failures(datagram, copy, len, offsets, lens, plains))
+    goto fail;
+
+  for (uint32_t k = 0U; k < PACKETS; k++)
+    free(plains[k]);
+  printf("datagram: ok\n");
+  return 0;
+
+fail:
+  free_states(states);
+  for (uint32_t k = 0U; k < PACKETS; k++)
+    free(plains[k]);
+  return 1;
+}
@@ -0,0 +1,227 @@
+/* Tests for key updates (RFC 9001, Section 6).
+ *
+ * A sender updates its keys with EverQuic_key_update and a receiver follows
+ * the Key Phase bit: EverQuic_decrypt tries the next generation of keys on a
+ * packet with the other phase and a packet number above those of the current
+ * phase, and only rotates once that packet authenticates. Packets reordered
+ * across an update decrypt with the previous keys; forged packets with the
+ * other phase, and EverQuic_decrypt_no_key_update, leave the keys alone. The
+ * generation derived by an update is checked against a state created
+ * directly from the "quic ku" secret of RFC 9001, Appendix A.5. Cursors
+ * follow one update of the peer without rotating the keys of the state. */
+
+#define TEST_NAME "keyupdate"
+#include "test.h"
+
+#define PN_LEN 2U
+#define PLAIN_LEN 32U
+#define PACKET_LEN (1U + CID_LEN + PN_LEN + PLAIN_LEN + 16U)
+#define PACKETS 8U
+
+/* The client 1-RTT secret and its update, from RFC 9001, Appendix A.5. */
+static uint8_t secret[32U] = {
+  0x9aU, 0xc3U, 0x12U, 0xa7U, 0xf8U, 0x77U, 0x46U, 0x8eU, 0xbeU, 0x69U, 0x42U, 0x27U, 0x48U, 0xadU,
+  0x00U, 0xa1U, 0x54U, 0x43U, 0xf1U, 0x82U, 0x03U, 0xa0U, 0x7dU, 0x60U, 0x60U, 0xf6U, 0x88U, 0xf3U,
+  0x0fU, 0x21U, 0x63U, 0x2bU
+};
+
+static uint8_t ku_secret[32U] = {
+  0x12U, 0x23U, 0x50U, 0x47U, 0x55U, 0x03U, 0x6dU, 0x55U, 0x63U, 0x42U, 0xeeU, 0x93U, 0x61U, 0xd2U,
+  0x53U, 0x42U, 0x1aU, 0x82U, 0x6cU, 0x9eU, 0xcdU, 0xf3U, 0xc7U, 0x14U, 0x86U, 0x84U, 0xb3U, 0x6bU,
+  0x71U, 0x48U, 0x81U, 0xf9U
+};
+
+static uint8_t plain[PLAIN_LEN];
+
+/* The packets, indexed by packet number; the sender starts at 1. */
+static uint8_t packets[PACKETS + 1U][PACKET_LEN];
+
+/* Encrypts the next packet of the sender, in its current key phase. */
+static int send(EverQuic_state_s *s, uint64_t expected)
+{
+  uint64_t pn;
+  CHECK(EverQuic_encrypt(s, packets[expected], &pn,
+    short_header(EverQuic_key_phase_of_state(s), PN_LEN), plain, PLAIN_LEN) == EverCrypt_Error_Success);
+  CHECK(pn == expected);
+  return 0;
+
+fail:
+  return 1;
+}
+
+/* Decrypts a copy of packet pn, which must authenticate, then checks the key
+   phase of the receiver. */
+static int receive(EverQuic_state_s *s, uint64_t pn, uint8_t phase)
+{
+  uint8_t packet[PACKET_LEN];
+  memcpy(packet, packets[pn], PACKET_LEN);
+  EverQuic_result r;
+  CHECK(EverQuic_decrypt(s, &r, packet, PACKET_LEN, CID_LEN) == EverQuic_Ok);
+  CHECK(r.pn == pn);
+  CHECK(memcmp(packet + r.header_len, plain, PLAIN_LEN) == 0);
+  CHECK(EverQuic_key_phase_of_state(s) == phase);
+  return 0;
+
+fail:
+  return 1;
+}
+
+/* Decrypts a copy of packet pn, which must fail to authenticate without
+   changing the key phase of the receiver. */
+static int reject(EverQuic_state_s *s, uint64_t pn, bool tamper)
+{
+  uint8_t phase = EverQuic_key_phase_of_state(s);
+  uint8_t packet[PACKET_LEN];
+  memcpy(packet, packets[pn], PACKET_LEN);
+  if (tamper)
+    packet[PACKET_LEN - 1U] ^= 1U;
+  EverQuic_result r;
+  CHECK(EverQuic_decrypt(s, &r, packet, PACKET_LEN, CID_LEN) == EverQuic_Unauthenticated);
+  CHECK(EverQuic_key_phase_of_state(s) == phase);
+  return 0;
+
+fail:
+  return 1;
+}
+
+static int run(EverQuic_index i)
+{
+  EverQuic_state_s *sender = NULL, *ref = NULL, *s = NULL;
+  EverQuic_cursor_s *c = NULL;
+
+  /* Packets 1-2 are sent with generation 0, 3-5 with generation 1 and 6-8
+     with generation 2. */
+  CHECK(EverQuic_create_in(i, &sender, 0U, secret) == EverCrypt_Error_Success);
+  for (uint64_t pn = 1U; pn <= PACKETS; pn++) {
+    if (pn == 3U || pn == 6U)
+      CHECK(EverQuic_key_update(sender) == EverCrypt_Error_Success);
+    if (send(sender, pn))
+      goto fail;
+  }
+  CHECK(EverQuic_key_phase_of_state(sender) == 0U);
+  free_state(&sender);
+
+  /* Generation 1 is the one derived from the "quic ku" secret: only the
+     header protection key, which is never updated, differs. */
+  {
+    CHECK(EverQuic_create_in(i, &ref, 2U, ku_secret) == EverCrypt_Error_Success);
+    uint8_t packet[PACKET_LEN];
+    uint64_t pn;
+    CHECK(EverQuic_encrypt(ref, packet, &pn, short_header(1U, PN_LEN), plain, PLAIN_LEN) ==
+      EverCrypt_Error_Success);
+    CHECK(pn == 3U);
+    uint32_t header_len = EverQuic_header_len(short_header(1U, PN_LEN));
+    CHECK(memcmp(packet + header_len, packets[3U] + header_len, PACKET_LEN - header_len) == 0);
+    free_state(&ref);
+  }
+
+  /* The peer updates twice; packets are reordered across both updates. */
+  CHECK(EverQuic_create_in(i, &s, 0U, secret) == EverCrypt_Error_Success);
+  if (receive(s, 1U, 0U))
+    goto fail;
+  /* A forged packet with the other phase does not rotate the keys. */
+  if (reject(s, 3U, true))
+    goto fail;
+  if (receive(s, 3U, 1U) || receive(s, 2U, 1U) || receive(s, 5U, 1U) || receive(s, 4U, 1U))
+    goto fail;
+  if (reject(s, 7U, true))
+    goto fail;
+  if (receive(s, 7U, 0U) || receive(s, 5U, 0U) || receive(s, 6U, 0U) || receive(s, 8U, 0U))
+    goto fail;
+  /* Generation 0 is gone; once the previous keys are discarded, so is
+     generation 1. */
+  if (reject(s, 2U, false))
+    goto fail;
+  EverQuic_discard_previous_keys(s);
+  if (reject(s, 4U, false) || receive(s, 6U, 0U))
+    goto fail;
+  free_state(&s);
+
+  /* The receiver updates first: peer packets with the old phase still use the
+     previous keys, before and after the first packet with the new phase. */
+  CHECK(EverQuic_create_in(i, &s, 0U, secret) == EverCrypt_Error_Success);
+  if (receive(s, 1U, 0U))
+    goto fail;
+  CHECK(EverQuic_key_update(s) == EverCrypt_Error_Success);
+  CHECK(EverQuic_key_phase_of_state(s) == 1U);
+  if (receive(s, 2U, 1U) || receive(s, 4U, 1U) || receive(s, 3U, 1U))
+    goto fail;
+  if (receive(s, 6U, 0U))
+    goto fail;
+  free_state(&s);
+
+  /* Without key updates, the next generation is never tried. */
+  {
+    CHECK(EverQuic_create_in(i, &s, 0U, secret) == EverCrypt_Error_Success);
+    uint8_t packet[PACKET_LEN];
+    EverQuic_result r;
+    memcpy(packet, packets[3U], PACKET_LEN);
+    CHECK(EverQuic_decrypt_no_key_update(s, &r, packet, PACKET_LEN, CID_LEN) ==
+      EverQuic_Unauthenticated);
+    CHECK(EverQuic_key_phase_of_state(s) == 0U);
+    if (receive(s, 3U, 1U))
+      goto fail;
+    free_state(&s);
+  }
+
+  /* Cursors follow one update of the peer without rotating the state, and
+     fail on the second one until the owner moves the state with
+     EverQuic_decrypt on a packet of the first one. */
+  {
+    CHECK(EverQuic_create_in(i, &s, 0U, secret) == EverCrypt_Error_Success);
+    CHECK(EverQuic_cursor_create_in(s, &c) == EverQuic_Ok);
+    uint8_t packet[PACKET_LEN];
+    EverQuic_result r;
+    uint64_t order[] = { 1U, 3U, 2U, 6U, 5U, 6U, 8U };
+    EverQuic_status expected[] = {
+      EverQuic_Ok, EverQuic_Ok, EverQuic_Ok, EverQuic_Unauthenticated, EverQuic_Ok, EverQuic_Ok,
+      EverQuic_Ok
+    };
+    for (uint32_t k = 0U; k < sizeof order / sizeof order[0U]; k++) {
+      if (k == 5U) {
+        /* The threads are quiescent: packet 3 rotates the state. */
+        CHECK(EverQuic_key_phase_of_state(s) == 0U);
+        if (receive(s, 3U, 1U))
+          goto fail;
+      }
+      memcpy(packet, packets[order[k]], PACKET_LEN);
+      CHECK(EverQuic_cursor_decrypt(s, c, &r, packet, PACKET_LEN, CID_LEN) == expected[k]);
+      if (expected[k] == EverQuic_Ok) {
+        CHECK(r.pn == order[k]);
+        CHECK(memcmp(packet + r.header_len, plain, PLAIN_LEN) == 0);
+      }
+      /* The phase of a packet accepted with the next keys signals the
+         pending update. */
+      if (k == 1U || k == 5U)
+        CHECK(r.header.case_BShort.phase != EverQuic_key_phase_of_state(s));
+    }
+    EverQuic_cursor_free(c);
+    c = NULL;
+    free_state(&s);
+  }
+  return 0;
+
+fail:
+  if (c != NULL)
+    EverQuic_cursor_free(c);
+  free_state(&sender);
+  free_state(&ref);
+  free_state(&s);
+  return 1;
+}
+
+int keyupdate_test(void)
+{
+  EverCrypt_AutoConfig2_init();
+  memset(plain, 0x5aU, PLAIN_LEN);
+  static const Spec_Agile_AEAD_alg algs[] = {
+    Spec_Agile_AEAD_AES128_GCM, Spec_Agile_AEAD_AES256_GCM, Spec_Agile_AEAD_CHACHA20_POLY1305
+  };
+  for (uint32_t k = 0U; k < sizeof algs / sizeof algs[0U]; k++) {
+    EverQuic_index i = { .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = algs[k] };
+    if (run(i))
+      return 1;
+  }
+  printf("keyupdate: ok\n");
+  return 0;
+}
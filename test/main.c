@@ -8,6 +8,10 @@ bool QUICTest_is_equal (uint8_t * b1, uint8_t * b2, uint32_t len) {
   return (memcmp(b1, b2, len) == 0);
 }
 
+int datagram_test (void);
+int replay_test (void);
+int keyupdate_test (void);
+
 int main () {
-  return QUICTest_test ();
+  return QUICTest_test () || datagram_test () || replay_test () || keyupdate_test ();
 }
@@ -0,0 +1,245 @@
+/* Tests for the replay window of EverQuic_create_in_with_replay_window.
+ *
+ * A sender encrypts a run of 1-RTT packets, which are then delivered to a
+ * receiver with a replay window in a pseudo-random order: in sequence, with
+ * reordering, duplicates, jumps of several windows at once (which recycle
+ * every word of the window) and packets too old for the window. The result
+ * of each EverQuic_decrypt is checked against a reference model of the
+ * window (QUIC.Spec.Replay): a packet is fresh if its number is above the
+ * largest accepted one, or less than the window size minus 64 below it and
+ * not yet accepted. A few boundary cases follow, for each window size, and
+ * unsupported window sizes, and cursors on a state with a window, are checked
+ * to be rejected. */
+
+#define TEST_NAME "replay"
+#include "test.h"
+
+#define PN_LEN 4U
+#define PLAIN_LEN 16U
+#define PACKET_LEN (1U + CID_LEN + PN_LEN + PLAIN_LEN + 16U)
+#define PACKETS 16400U
+#define STEPS (4U * PACKETS)
+
+static uint8_t secret[32U] = {
+  0x9aU, 0xc3U, 0x12U, 0xa7U, 0xf8U, 0x77U, 0x46U, 0x8eU, 0xbeU, 0x69U, 0x42U, 0x27U, 0x48U, 0xadU,
+  0x00U, 0xa1U, 0x54U, 0x43U, 0xf1U, 0x82U, 0x03U, 0xa0U, 0x7dU, 0x60U, 0x60U, 0xf6U, 0x88U, 0xf3U,
+  0x0fU, 0x21U, 0x63U, 0x2bU
+};
+
+static uint8_t plain[PLAIN_LEN];
+
+/* The packets, indexed by packet number; the sender starts at 1. */
+static uint8_t packets[PACKETS + 1U][PACKET_LEN];
+
+/* The reference model: the packet numbers accepted so far. */
+static bool accepted[PACKETS + 1U];
+
+static EverQuic_index index_ = {
+  .hash_alg = Spec_Hash_Definitions_SHA2_256, .aead_alg = Spec_Agile_AEAD_AES128_GCM
+};
+
+/* A deterministic xorshift generator, so that failures can be reproduced. */
+static uint32_t next_random(uint32_t *seed)
+{
+  uint32_t x = *seed;
+  x ^= x << 13U;
+  x ^= x >> 17U;
+  x ^= x << 5U;
+  *seed = x;
+  return x;
+}
+
+/* Decrypts a copy of packet pn and checks the result against the model, which
+   is then updated. */
+static int deliver(EverQuic_state_s *s, uint64_t pn, uint64_t *last, uint64_t span,
+  uint32_t *fresh, uint32_t *replayed)
+{
+  uint8_t packet[PACKET_LEN];
+  memcpy(packet, packets[pn], PACKET_LEN);
+  EverQuic_result r;
+  EverQuic_status err = EverQuic_decrypt(s, &r, packet, PACKET_LEN, CID_LEN);
+  CHECK(r.pn == pn);
+  if (pn > *last || (*last - pn < span && !accepted[pn])) {
+    CHECK(err == EverQuic_Ok);
+    CHECK(memcmp(packet + r.header_len, plain, PLAIN_LEN) == 0);
+    accepted[pn] = true;
+    if (pn > *last)
+      *last = pn;
+    (*fresh)++;
+  } else {
+    CHECK(err == EverQuic_Replayed);
+    CHECK(r.total_len == PACKET_LEN);
+    /* No AEAD was run: the payload is still encrypted. */
+    CHECK(memcmp(packet + r.header_len, packets[pn] + r.header_len, PLAIN_LEN + 16U) == 0);
+    (*replayed)++;
+  }
+  CHECK(EverQuic_last_packet_number_of_state(s) == *last);
+  return 0;
+
+fail:
+  return 1;
+}
+
+static int shuffled(uint32_t bits, uint32_t seed)
+{
+  EverQuic_state_s *s = NULL;
+  CHECK(EverQuic_create_in_with_replay_window(index_, &s, 0U, secret, bits) == EverQuic_Ok);
+  memset(accepted, 0, sizeof accepted);
+  uint64_t span = bits - 64U;
+  uint64_t last = 0U;
+  /* The lowest packet number not yet delivered in sequence. */
+  uint64_t front = 1U;
+  uint32_t fresh = 0U, replayed = 0U;
+  for (uint32_t step = 0U; step < STEPS; step++) {
+    uint32_t c = next_random(&seed) % 10U;
+    uint64_t pn;
+    if (c < 4U)
+      /* In sequence. */
+      pn = front;
+    else if (c < 5U)
+      /* A little ahead, leaving a gap to be filled by reordered packets. */
+      pn = front + next_random(&seed) % 200U;
+    else if (c < 6U)
+      /* Several windows ahead: every word of the window is recycled. */
+      pn = front + 2U * bits + next_random(&seed) % 64U;
+    else if (c < 9U) {
+      /* Reordered, duplicated or too old, on both sides of the edge of the
+         window. */
+      uint64_t back = next_random(&seed) % (span + 128U);
+      pn = last > back ? last - back : 1U;
+    } else
+      /* The largest packet number accepted so far, again. */
+      pn = last > 0U ? last : 1U;
+    if (pn > PACKETS)
+      continue;
+    if (pn >= front)
+      front = pn + 1U;
+    if (deliver(s, pn, &last, span, &fresh, &replayed))
+      goto fail;
+  }
+  CHECK(fresh > 100U && replayed > 100U);
+  free_state(&s);
+  return 0;
+
+fail:
+  free_state(&s);
+  return 1;
+}
+
+static int boundaries(uint32_t bits)
+{
+  EverQuic_state_s *s = NULL;
+  CHECK(EverQuic_create_in_with_replay_window(index_, &s, 0U, secret, bits) == EverQuic_Ok);
+  memset(accepted, 0, sizeof accepted);
+  uint64_t span = bits - 64U;
+  uint64_t last = 0U;
+  uint32_t fresh = 0U, replayed = 0U;
+
+  /* Far enough that the oldest packets inside the window map to the same
+     word as packets above last. */
+  uint64_t top = 3U * bits + 5U;
+  uint64_t pns[] = {
+    top, top, top - 1U, top - span + 1U, top - span, top - span - 1U, top - span + 1U,
+    /* The word of the next packet is recycled. */
+    top + 64U, top - span + 1U, top,
+    /* One whole window ahead, landing on the same bit. */
+    top + bits, top + 64U, top + bits - span + 1U
+  };
+  for (uint32_t k = 0U; k < sizeof pns / sizeof pns[0U]; k++)
+    if (deliver(s, pns[k], &last, span, &fresh, &replayed))
+      goto fail;
+  CHECK(fresh == 6U && replayed == 7U);
+
+  /* A replayed packet that also fails to authenticate is a replay. */
+  uint8_t packet[PACKET_LEN];
+  EverQuic_result r;
+  memcpy(packet, packets[last], PACKET_LEN);
+  packet[PACKET_LEN - 1U] ^= 1U;
+  CHECK(EverQuic_decrypt(s, &r, packet, PACKET_LEN, CID_LEN) == EverQuic_Replayed);
+
+  /* A fresh packet that fails to authenticate does not enter the window. */
+  memcpy(packet, packets[last + 1U], PACKET_LEN);
+  packet[PACKET_LEN - 1U] ^= 1U;
+  CHECK(EverQuic_decrypt(s, &r, packet, PACKET_LEN, CID_LEN) == EverQuic_Unauthenticated);
+  CHECK(EverQuic_last_packet_number_of_state(s) == last);
+  if (deliver(s, last + 1U, &last, span, &fresh, &replayed))
+    goto fail;
+
+  /* Duplicates within one batch are caught. */
+  uint8_t copies[4U][PACKET_LEN];
+  uint64_t order[4U] = { last + 1U, last, last + 1U, last - 2U };
+  EverQuic_decrypt_desc descs[4U];
+  for (uint32_t k = 0U; k < 4U; k++) {
+    memcpy(copies[k], packets[order[k]], PACKET_LEN);
+    descs[k].packet = copies[k];
+    descs[k].packet_len = PACKET_LEN;
+  }
+  EverQuic_decrypt_batch(s, descs, 4U, CID_LEN);
+  CHECK(descs[0U].err == EverQuic_Ok);
+  CHECK(descs[1U].err == EverQuic_Replayed);
+  CHECK(descs[2U].err == EverQuic_Replayed);
+  CHECK(descs[3U].err == EverQuic_Ok);
+
+  /* The window cannot be shared through cursors. */
+  EverQuic_cursor_s *c = NULL;
+  CHECK(EverQuic_cursor_create_in(s, &c) == EverQuic_HasReplayWindow);
+  CHECK(c == NULL);
+
+  free_state(&s);
+  return 0;
+
+fail:
+  free_state(&s);
+  return 1;
+}
+
+/* Window sizes other than the powers of two from 128 to 4096 bits are
+   rejected, without creating a state. */
+static int invalid_sizes(void)
+{
+  static const uint32_t sizes[] = { 0U, 1U, 32U, 64U, 96U, 192U, 1000U, 4095U, 8192U, 0x80000000U };
+  EverQuic_state_s *s = NULL;
+  for (uint32_t k = 0U; k < sizeof sizes / sizeof sizes[0U]; k++) {
+    CHECK(!EverQuic_valid_window_bits(sizes[k]));
+    CHECK(EverQuic_create_in_with_replay_window(index_, &s, 0U, secret, sizes[k]) ==
+      EverQuic_InvalidWindowSize);
+    CHECK(s == NULL);
+  }
+  return 0;
+
+fail:
+  free_state(&s);
+  return 1;
+}
+
+int replay_test(void)
+{
+  EverCrypt_AutoConfig2_init();
+  memset(plain, 0x5aU, PLAIN_LEN);
+  EverQuic_state_s *sender = NULL;
+  CHECK(EverQuic_create_in(index_, &sender, 0U, secret) == EverCrypt_Error_Success);
+  for (uint64_t pn = 1U; pn <= PACKETS; pn++) {
+    uint64_t sent;
+    CHECK(EverQuic_encrypt(sender, packets[pn], &sent, short_header(0U, PN_LEN), plain, PLAIN_LEN) ==
+      EverCrypt_Error_Success);
+    CHECK(sent == pn);
+  }
+  free_state(&sender);
+
+  if (invalid_sizes())
+    return 1;
+  static const uint32_t sizes[] = { 128U, 256U, 1024U, 4096U };
+  for (uint32_t k = 0U; k < sizeof sizes / sizeof sizes[0U]; k++) {
+    CHECK(EverQuic_valid_window_bits(sizes[k]));
+    if (shuffled(sizes[k], 0x2545f491U + k))
+      return 1;
+    if (boundaries(sizes[k]))
+      return 1;
+  }
+  printf("replay: ok\n");
+  return 0;
+
+fail:
+  free_state(&sender);
+  return 1;
+}
@@ -0,0 +1,54 @@
+/* Fixtures shared by the C tests of EverQuic (test/datagram.c,
+ * test/replay.c, test/keyupdate.c). Each test file defines TEST_NAME, the
+ * prefix of its messages, before including this header. */
+
+#ifndef __EverQuic_Test_H
+#define __EverQuic_Test_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EverQuic.h"
+
+extern void EverCrypt_AutoConfig2_init(void);
+
+/* Reports a failed check, then jumps to the fail label of the enclosing
+   function, which releases what the function allocated and returns 1. */
+#define CHECK(c)                                                               \
+  do {                                                                         \
+    if (!(c)) {                                                                \
+      printf("%s: %s:%d: check failed: %s\n", TEST_NAME, __FILE__, __LINE__,   \
+        #c);                                                                   \
+      goto fail;                                                               \
+    }                                                                          \
+  } while (0)
+
+#define CID_LEN 8U
+
+static uint8_t cid[CID_LEN] = { 0x83U, 0x94U, 0xc8U, 0xf0U, 0x3eU, 0x51U, 0x57U, 0x08U };
+
+/* A 1-RTT header for cid, with key phase bit phase. */
+static inline EverQuic_header short_header(uint8_t phase, uint32_t pn_len)
+{
+  EverQuic_header h;
+  memset(&h, 0, sizeof h);
+  h.tag = EverQuic_BShort;
+  h.case_BShort.phase = phase;
+  h.case_BShort.cid = cid;
+  h.case_BShort.cid_len = CID_LEN;
+  h.case_BShort.packet_number_length = pn_len;
+  return h;
+}
+
+/* Frees *s, if any, and clears it, so that fail labels can release every
+   state of their function whether or not it was created or freed. */
+static inline void free_state(EverQuic_state_s **s)
+{
+  if (*s != NULL) {
+    EverQuic_free(*s);
+    *s = NULL;
+  }
+}
+
+#endif